@@ -0,0 +1,259 @@
+#include "../include/json_serializer.h"
+#include "../include/json_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Micro-benchmarks of the serializer, one json line per workload on stdout:
+ *
+ * {"bench":"flat_telemetry","iterations":...,"ns_per_op":...,
+ *  "mb_per_s":...,"bytes_per_op":...}
+ *
+ * An optional argument only runs the workloads whose name contains it.
+ */
+
+/** Measuring time of a workload, after calibration. */
+#define BENCH_TARGET_NS 200000000.0
+
+static char out[64 * 1024];
+
+/* keep the optimizer from dropping the serialization */
+static volatile size_t sink;
+
+static double now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* workloads, each one serializes a document in out and returns its length */
+
+static size_t flat_telemetry(void) {
+  char *buf = out;
+  size_t rem = sizeof(out);
+
+  buf = json_obj_open(buf, NULL, &rem);
+  buf = json_kv_str(buf, "device", "probe-0042", &rem);
+  buf = json_kv_uint64(buf, "ts", 1700000000123ULL, &rem);
+  buf = json_kv_int32(buf, "seq", 184467, &rem);
+  buf = json_kv_double(buf, "temp", 21.375, &rem);
+  buf = json_kv_double(buf, "humidity", 48.25, &rem);
+  buf = json_kv_double_fixed(buf, "pressure", 1013.2512, 2, &rem);
+  buf = json_kv_int32(buf, "rssi", -67, &rem);
+  buf = json_kv_bool(buf, "charging", 0, &rem);
+  buf = json_kv_str(buf, "fw", "1.4.2-rc1", &rem);
+  buf = json_kv_null(buf, "error", &rem);
+  buf = json_obj_close(buf, &rem);
+  buf = json_end(buf, &rem);
+
+  return buf ? (size_t)(buf - out) : 0;
+}
+
+static size_t deep_nesting(void) {
+  char *buf = out;
+  size_t rem = sizeof(out);
+
+  for (int i = 0; i < 32; ++i) {
+    buf = json_obj_open(buf, NULL, &rem);
+    buf = json_kv_int32(buf, "level", i, &rem);
+    buf = json_arr_open(buf, "children", &rem);
+  }
+
+  for (int i = 0; i < 32; ++i) {
+    buf = json_arr_close(buf, &rem);
+    buf = json_obj_close(buf, &rem);
+  }
+  buf = json_end(buf, &rem);
+
+  return buf ? (size_t)(buf - out) : 0;
+}
+
+static char long_ascii_text[4096 + 1];
+static char escape_heavy_text[4096 + 1];
+static char utf8_text[4096 + 1];
+
+static size_t string_document(const char *text) {
+  char *buf = out;
+  size_t rem = sizeof(out);
+
+  buf = json_str(buf, text, &rem);
+  buf = json_end(buf, &rem);
+
+  return buf ? (size_t)(buf - out) : 0;
+}
+
+static size_t long_ascii(void) { return string_document(long_ascii_text); }
+
+static size_t escape_heavy(void) { return string_document(escape_heavy_text); }
+
+static size_t utf8(void) { return string_document(utf8_text); }
+
+/* the same strings counted by a measuring writer, nothing is written */
+static size_t measure_document(const char *text) {
+  json_writer_t w;
+
+  json_writer_init_measure(&w);
+  json_writer_str(&w, text);
+
+  return (json_writer_finish(&w) == JSON_OK) ? json_writer_length(&w) : 0;
+}
+
+static size_t escape_heavy_measure(void) {
+  return measure_document(escape_heavy_text);
+}
+
+static size_t utf8_measure(void) { return measure_document(utf8_text); }
+
+static int32_t samples[4096];
+
+static size_t int_array(void) {
+  char *buf = out;
+  size_t rem = sizeof(out);
+
+  buf = json_arr_open(buf, NULL, &rem);
+  for (size_t i = 0; i < sizeof(samples) / sizeof(*samples); ++i)
+    buf = json_int32(buf, samples[i], &rem);
+  buf = json_arr_close(buf, &rem);
+  buf = json_end(buf, &rem);
+
+  return buf ? (size_t)(buf - out) : 0;
+}
+
+static size_t int_array_bulk(void) {
+  char *buf = out;
+  size_t rem = sizeof(out);
+
+  buf = json_arr_int32(buf, NULL, samples, sizeof(samples) / sizeof(*samples),
+                       &rem);
+  buf = json_end(buf, &rem);
+
+  return buf ? (size_t)(buf - out) : 0;
+}
+
+static void setup(void) {
+  static const char *const words[] = {"sensor", "value", "reading", "ok",
+                                      "state", "link", "battery", "uptime"};
+  /* 2, 3 and 4 bytes sequences: e acute, CJK, emoji */
+  static const char *const glyphs[] = {"\xc3\xa9", "\xe6\x97\xa5",
+                                       "\xf0\x9f\x91\x8d", "a"};
+
+  size_t len = 0;
+  for (size_t i = 0; len + 8 < sizeof(long_ascii_text); ++i) {
+    const char *word = words[i % 8];
+    memcpy(long_ascii_text + len, word, strlen(word));
+    len += strlen(word);
+    long_ascii_text[len++] = ' ';
+  }
+  long_ascii_text[len] = '\0';
+
+  /* a character to escape every 4 bytes */
+  for (len = 0; len < sizeof(escape_heavy_text) - 1; ++len)
+    escape_heavy_text[len] = "ab\"c\\de\nf/gh\t"[len % 13];
+  escape_heavy_text[len] = '\0';
+
+  len = 0;
+  for (size_t i = 0; len + 4 < sizeof(utf8_text); ++i) {
+    const char *glyph = glyphs[i % 4];
+    memcpy(utf8_text + len, glyph, strlen(glyph));
+    len += strlen(glyph);
+  }
+  utf8_text[len] = '\0';
+
+  uint32_t x = 2463534242u;
+  for (size_t i = 0; i < sizeof(samples) / sizeof(*samples); ++i) {
+    /* xorshift, samples of every length and sign */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    samples[i] = (int32_t)x >> (x % 31);
+  }
+}
+
+typedef struct {
+  const char *name;
+  size_t (*run)(void);
+} bench_t;
+
+static const bench_t benches[] = {
+    {"flat_telemetry", flat_telemetry},
+    {"deep_nesting", deep_nesting},
+    {"long_ascii", long_ascii},
+    {"escape_heavy", escape_heavy},
+    {"utf8", utf8},
+    {"escape_heavy_measure", escape_heavy_measure},
+    {"utf8_measure", utf8_measure},
+    {"int_array", int_array},
+    {"int_array_bulk", int_array_bulk},
+};
+
+static int report(const char *name, uint64_t iterations, double ns_per_op,
+                  size_t bytes) {
+  char line[256];
+  json_writer_t w;
+
+  json_writer_init(&w, line, sizeof(line));
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_str(&w, "bench", name);
+  json_writer_kv_uint64(&w, "iterations", iterations);
+  json_writer_kv_double_fixed(&w, "ns_per_op", ns_per_op, 1);
+  json_writer_kv_double_fixed(&w, "mb_per_s", bytes * 1e3 / ns_per_op, 1);
+  json_writer_kv_uint64(&w, "bytes_per_op", bytes);
+  json_writer_obj_close(&w);
+
+  if (json_writer_finish(&w) != JSON_OK)
+    return -1;
+
+  puts(line);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *filter = (argc > 1) ? argv[1] : NULL;
+
+  setup();
+
+  for (size_t i = 0; i < sizeof(benches) / sizeof(*benches); ++i) {
+    const bench_t *bench = &benches[i];
+
+    if (filter && !strstr(bench->name, filter))
+      continue;
+
+    size_t bytes = bench->run();
+    if (bytes == 0) {
+      fprintf(stderr, "%s: serialization failed\n", bench->name);
+      return 1;
+    }
+
+    /* double the iterations until a run is long enough to be timed */
+    uint64_t iterations = 1;
+    double elapsed;
+
+    for (;;) {
+      double start = now_ns();
+      for (uint64_t n = 0; n < iterations; ++n)
+        sink = bench->run();
+      elapsed = now_ns() - start;
+
+      if (elapsed >= BENCH_TARGET_NS / 10)
+        break;
+      iterations *= 2;
+    }
+
+    iterations = (uint64_t)(iterations * (BENCH_TARGET_NS / elapsed)) + 1;
+
+    double start = now_ns();
+    for (uint64_t n = 0; n < iterations; ++n)
+      sink = bench->run();
+    elapsed = now_ns() - start;
+
+    if (report(bench->name, iterations, elapsed / iterations, bytes))
+      return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+#ifndef JSON_SCHEMA_H_
+#define JSON_SCHEMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_writer.h"
+
+/**
+ * @brief Serializers generated from a list of struct fields.
+ *
+ * The fields of a struct are declared once as an X-macro taking the field
+ * macro F(type, field):
+ *
+ *   #define SENSOR_FIELDS(F)                                                 \
+ *     F(int32, id)                                                           \
+ *     F(double, temp)                                                        \
+ *     F(str, name)                                                           \
+ *     F(bool, online)
+ *
+ *   JSON_SCHEMA_DEFINE(sensor, struct sensor, SENSOR_FIELDS)
+ *
+ * defines json_serialize_sensor(w, value), writing the struct as an object,
+ * and json_sensor_max_size. The function is a straight sequence of writer
+ * calls: keys are the field names, string literals copied without escaping,
+ * and every value uses the emitter of its type, no per field dispatch.
+ * Without string fields the whole object is reserved once and written with
+ * the unchecked emitters.
+ *
+ * Types: int32, int64, uint64, double, float, bool and str (const char *).
+ */
+
+/** Writer call of each field type. */
+#define JSON_SCHEMA_WRITE_int32(w, v) json_writer_int32((w), (v))
+#define JSON_SCHEMA_WRITE_int64(w, v) json_writer_int64((w), (v))
+#define JSON_SCHEMA_WRITE_uint64(w, v) json_writer_uint64((w), (v))
+#define JSON_SCHEMA_WRITE_double(w, v) json_writer_double((w), (v))
+#define JSON_SCHEMA_WRITE_float(w, v) json_writer_float((w), (v))
+#define JSON_SCHEMA_WRITE_bool(w, v) json_writer_bool((w), (v))
+#define JSON_SCHEMA_WRITE_str(w, v) json_writer_str((w), (v))
+
+/** Longest value of each field type, strings without their content. */
+#define JSON_SCHEMA_MAX_int32 JSON_MAX_LEN_INT32
+#define JSON_SCHEMA_MAX_int64 JSON_MAX_LEN_INT64
+#define JSON_SCHEMA_MAX_uint64 JSON_MAX_LEN_UINT64
+#define JSON_SCHEMA_MAX_double JSON_MAX_LEN_DOUBLE
+#define JSON_SCHEMA_MAX_float JSON_MAX_LEN_FLOAT
+#define JSON_SCHEMA_MAX_bool JSON_MAX_LEN_BOOL
+#define JSON_SCHEMA_MAX_str JSON_MAX_LEN_STR(0)
+
+/**
+ * Unchecked writer call of each field type. Strings are not bounded, a
+ * schema with strings never takes the unchecked path.
+ */
+#define JSON_SCHEMA_UNCHECKED_int32(w, v) json_writer_int32_unchecked((w), (v))
+#define JSON_SCHEMA_UNCHECKED_int64(w, v) json_writer_int64_unchecked((w), (v))
+#define JSON_SCHEMA_UNCHECKED_uint64(w, v)                                     \
+  json_writer_uint64_unchecked((w), (v))
+#define JSON_SCHEMA_UNCHECKED_double(w, v)                                     \
+  json_writer_double_unchecked((w), (v))
+#define JSON_SCHEMA_UNCHECKED_float(w, v) json_writer_float_unchecked((w), (v))
+#define JSON_SCHEMA_UNCHECKED_bool(w, v) json_writer_bool_unchecked((w), (v))
+#define JSON_SCHEMA_UNCHECKED_str(w, v) json_writer_str((w), (v))
+
+/** Whether the values of each field type have a bounded length. */
+#define JSON_SCHEMA_BOUNDED_int32 1
+#define JSON_SCHEMA_BOUNDED_int64 1
+#define JSON_SCHEMA_BOUNDED_uint64 1
+#define JSON_SCHEMA_BOUNDED_double 1
+#define JSON_SCHEMA_BOUNDED_float 1
+#define JSON_SCHEMA_BOUNDED_bool 1
+#define JSON_SCHEMA_BOUNDED_str 0
+
+#define JSON_SCHEMA_FIELD_UNCHECKED_(type, field)                              \
+  JSON_WRITER_KEY_UNCHECKED(w, #field);                                        \
+  JSON_SCHEMA_UNCHECKED_##type(w, value->field);
+
+#define JSON_SCHEMA_BOUNDED_(type, field) &&JSON_SCHEMA_BOUNDED_##type
+
+#define JSON_SCHEMA_FIELD_(type, field)                                        \
+  JSON_WRITER_KEY(w, #field);                                                  \
+  JSON_SCHEMA_WRITE_##type(w, value->field);
+
+/* ',' "field": and the value */
+#define JSON_SCHEMA_SIZE_(type, field)                                         \
+  +(1 + JSON_MAX_LEN_KEY_LITERAL(#field) + JSON_SCHEMA_MAX_##type)
+
+/**
+ * @brief Define json_serialize_<name>() and json_<name>_max_size.
+ *
+ * json_<name>_max_size is the longest object the function writes, without
+ * null byte. String fields are counted without their content, add
+ * JSON_MAX_LEN_STR(len) - 2 for each of them.
+ *
+ * @param name suffix of the generated names.
+ * @param type struct type, json_serialize_<name>() takes a const type *.
+ * @param FIELDS X-macro listing the fields.
+ */
+#define JSON_SCHEMA_DEFINE(name, type, FIELDS)                                 \
+  enum {                                                                       \
+    json_##name##_max_size = 2 FIELDS(JSON_SCHEMA_SIZE_),                      \
+    json_##name##_bounded = 1 FIELDS(JSON_SCHEMA_BOUNDED_)                     \
+  };                                                                           \
+                                                                               \
+  static inline void json_serialize_##name(json_writer_t *w,                   \
+                                           const type *value) {                \
+    json_writer_obj_open(w, NULL);                                             \
+                                                                               \
+    if (json_##name##_bounded &&                                               \
+        json_writer_reserve(w, json_##name##_max_size)) {                      \
+      FIELDS(JSON_SCHEMA_FIELD_UNCHECKED_)                                     \
+    } else {                                                                   \
+      FIELDS(JSON_SCHEMA_FIELD_)                                               \
+    }                                                                          \
+                                                                               \
+    json_writer_obj_close(w);                                                  \
+  }
+
+#endif /* ifndef JSON_SCHEMA_H_ */
@@ -1,14 +1,66 @@
 #ifndef JSON_SERIALIZER_H_
 #define JSON_SERIALIZER_H_
 
+#include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * @brief JSON Serializer header.
+ *
+ * Tokens are not null terminated, the last byte of the buffer is always kept
+ * for the null byte written by json_end().
+ *
+ * Every value is followed by a ',', the next close or json_end() removes it
+ * by looking at buf[-1]. A close or json_end() cannot be the first write into
+ * a buffer, buf[-1] must be readable: the writer API (json_writer.h) has no
+ * such limit.
  */
 
 /**
- * @brief Close json. (remove the last ,)
+ * @brief Worst case length of every token, for buffers sized at compile time.
+ *
+ * A document takes at most the sum of its tokens, one ',' more for each of
+ * them, and the null byte. A buffer of that size never runs out of space,
+ * with this API as with the writer:
+ *
+ *   char json[JSON_MAX_LEN_OPEN + 1 + JSON_MAX_LEN_KEY_LITERAL("id") + 1 +
+ *             JSON_MAX_LEN_NUMBER + 1 + JSON_MAX_LEN_CLOSE + 1 + 1];
+ *
+ * holds {"id":<any long>}.
+ */
+#define JSON_MAX_LEN_OPEN 1
+#define JSON_MAX_LEN_CLOSE 1
+#define JSON_MAX_LEN_BOOL 5
+#define JSON_MAX_LEN_NULL 4
+#define JSON_MAX_LEN_INT32 11
+#define JSON_MAX_LEN_INT64 20
+#define JSON_MAX_LEN_UINT64 20
+#if LONG_MAX > 0x7fffffffL
+#define JSON_MAX_LEN_NUMBER JSON_MAX_LEN_INT64
+#else
+#define JSON_MAX_LEN_NUMBER JSON_MAX_LEN_INT32
+#endif
+#define JSON_MAX_LEN_DOUBLE 25
+#define JSON_MAX_LEN_FLOAT JSON_MAX_LEN_DOUBLE
+#define JSON_MAX_LEN_DOUBLE_FIXED 31
+
+/** String of len bytes, every byte may take a 6 bytes \u00XX escape. */
+#define JSON_MAX_LEN_STR(len) (2 + 6 * (size_t)(len))
+/** Key of len bytes, ':' included. A named open is a key and an open. */
+#define JSON_MAX_LEN_KEY(len) (JSON_MAX_LEN_STR(len) + 1)
+/** Key from a string literal, see JSON_KEY(). Exact, it is not escaped. */
+#define JSON_MAX_LEN_KEY_LITERAL(lit) (sizeof("" lit) + 2)
+#define JSON_MAX_LEN_BASE64(len) (2 + 4 * (((size_t)(len) + 2) / 3))
+#define JSON_MAX_LEN_HEX(len) (2 + 2 * (size_t)(len))
+/** Typed arrays of count elements, the separators included. */
+#define JSON_MAX_LEN_ARR_INT32(count) (2 + (JSON_MAX_LEN_INT32 + 1) * (count))
+#define JSON_MAX_LEN_ARR_DOUBLE(count)                                         \
+  (2 + (JSON_MAX_LEN_DOUBLE + 1) * (count))
+#define JSON_MAX_LEN_ARR_BOOL(count) (2 + (JSON_MAX_LEN_BOOL + 1) * (count))
+
+/**
+ * @brief Close json. (remove the last , and write the null byte)
  *
  * @param buf json write-out buffer.
  * @param remaining_size buf remaining size.
@@ -66,8 +118,315 @@ char *json_null(char *buf, size_t *remaining_size);
 
 char *json_str(char *buf, const char *str, size_t *remaining_size);
 
+/**
+ * @brief Write a string of known length, not null terminated.
+ *
+ * For slices of packet buffers and records, no copy is needed to add a
+ * terminator. Null bytes in str are written as \u0000.
+ *
+ * @param buf json write-out buffer.
+ * @param str string.
+ * @param len length of str.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_strn(char *buf, const char *str, size_t len,
+                size_t *remaining_size);
+
 char *json_number(char *buf, long number, size_t *remaining_size);
 
+/**
+ * @brief Write a whole array of samples, brackets included.
+ *
+ * Much faster than a call per element: the elements are formatted in a
+ * single loop with one capacity check per batch.
+ *
+ * @param buf json write-out buffer.
+ * @param name object key, NULL for unnamed array.
+ * @param values elements.
+ * @param count number of elements.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_arr_int32(char *buf, const char *name, const int32_t *values,
+                     size_t count, size_t *remaining_size);
+char *json_arr_double(char *buf, const char *name, const double *values,
+                      size_t count, size_t *remaining_size);
+char *json_arr_bool(char *buf, const char *name, const int *values,
+                    size_t count, size_t *remaining_size);
+
+/**
+ * @brief Write binary data as a base64 (RFC 4648, padded) or lowercase hex
+ * string.
+ *
+ * Encoded straight into buf, the alphabets need no escaping.
+ *
+ * @param buf json write-out buffer.
+ * @param data bytes to encode.
+ * @param len number of bytes in data.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_base64(char *buf, const void *data, size_t len,
+                  size_t *remaining_size);
+char *json_hex(char *buf, const void *data, size_t len,
+               size_t *remaining_size);
+
+/**
+ * @brief Write a pre-serialized json value, such as a cached sub-document.
+ *
+ * The value is copied as is, only the separators around it are written. An
+ * empty value returns NULL. Built with JSON_VALIDATE_RAW (meson validate_raw
+ * option, on for debug builds) it is checked first and an invalid value
+ * returns NULL.
+ *
+ * @param buf json write-out buffer.
+ * @param json one json value.
+ * @param len length of json.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_raw(char *buf, const char *json, size_t len,
+               size_t *remaining_size);
+
+/**
+ * @brief Write an integer.
+ *
+ * @param buf json write-out buffer.
+ * @param number value, the full range of the type is supported.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_int64(char *buf, int64_t number, size_t *remaining_size);
+char *json_uint64(char *buf, uint64_t number, size_t *remaining_size);
+char *json_int32(char *buf, int32_t number, size_t *remaining_size);
+
+/**
+ * @brief Write the shortest decimal form parsing back to the same number.
+ *
+ * Integral values keep a ".0", exponents are used below 1e-6 and from 1e21.
+ * NaN and infinity have no json representation and are written as null.
+ *
+ * @param buf json write-out buffer.
+ * @param number value.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_double(char *buf, double number, size_t *remaining_size);
+char *json_float(char *buf, float number, size_t *remaining_size);
+
+/**
+ * @brief Write a number with a fixed count of digits after the decimal point.
+ *
+ * Cheaper than json_double() on targets without floating point unit.
+ *
+ * @param buf json write-out buffer.
+ * @param number value.
+ * @param precision digits after the decimal point, at most 9.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_double_fixed(char *buf, double number, unsigned int precision,
+                        size_t *remaining_size);
+
+/**
+ * @brief Write an object key, the value is written by the next call.
+ *
+ * @param buf json write-out buffer.
+ * @param name key, escaped like json_str().
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_key(char *buf, const char *name, size_t *remaining_size);
+
+/**
+ * @brief Write an object key that never needs escaping.
+ *
+ * The key is copied as is, see JSON_KEY() and the json_tkv_ macros for
+ * string literals.
+ *
+ * @param buf json write-out buffer.
+ * @param name key, without any character to escape.
+ * @param len length of name.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_key_trusted(char *buf, const char *name, size_t len,
+                       size_t *remaining_size);
+
+/**
+ * @brief Write a "name":value member of an object.
+ *
+ * @param buf json write-out buffer.
+ * @param name key, escaped like json_str().
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_kv_str(char *buf, const char *name, const char *str,
+                  size_t *remaining_size);
+char *json_kv_strn(char *buf, const char *name, const char *str, size_t len,
+                   size_t *remaining_size);
+char *json_kv_number(char *buf, const char *name, long number,
+                     size_t *remaining_size);
+char *json_kv_int64(char *buf, const char *name, int64_t number,
+                    size_t *remaining_size);
+char *json_kv_uint64(char *buf, const char *name, uint64_t number,
+                     size_t *remaining_size);
+char *json_kv_int32(char *buf, const char *name, int32_t number,
+                    size_t *remaining_size);
+char *json_kv_double(char *buf, const char *name, double number,
+                     size_t *remaining_size);
+char *json_kv_float(char *buf, const char *name, float number,
+                    size_t *remaining_size);
+char *json_kv_double_fixed(char *buf, const char *name, double number,
+                           unsigned int precision, size_t *remaining_size);
+char *json_kv_bool(char *buf, const char *name, int boolean,
+                   size_t *remaining_size);
+char *json_kv_null(char *buf, const char *name, size_t *remaining_size);
+char *json_kv_base64(char *buf, const char *name, const void *data,
+                     size_t len, size_t *remaining_size);
+char *json_kv_hex(char *buf, const char *name, const void *data, size_t len,
+                  size_t *remaining_size);
+char *json_kv_raw(char *buf, const char *name, const char *json, size_t len,
+                  size_t *remaining_size);
+
+/**
+ * @brief Key from a string literal, copied without escaping.
+ *
+ * Only accepts string literals, their length is known at compile time.
+ */
+#define JSON_KEY(buf, lit, remaining_size)                                     \
+  json_key_trusted((buf), "" lit, sizeof(lit) - 1, (remaining_size))
+
+/**
+ * @brief Members with a string literal key, see JSON_KEY().
+ */
+#define json_tkv_str(buf, lit, str, remaining_size)                            \
+  json_str(JSON_KEY(buf, lit, remaining_size), (str), (remaining_size))
+#define json_tkv_number(buf, lit, number, remaining_size)                      \
+  json_number(JSON_KEY(buf, lit, remaining_size), (number), (remaining_size))
+#define json_tkv_int64(buf, lit, number, remaining_size)                       \
+  json_int64(JSON_KEY(buf, lit, remaining_size), (number), (remaining_size))
+#define json_tkv_uint64(buf, lit, number, remaining_size)                      \
+  json_uint64(JSON_KEY(buf, lit, remaining_size), (number), (remaining_size))
+#define json_tkv_int32(buf, lit, number, remaining_size)                       \
+  json_int32(JSON_KEY(buf, lit, remaining_size), (number), (remaining_size))
+#define json_tkv_double(buf, lit, number, remaining_size)                      \
+  json_double(JSON_KEY(buf, lit, remaining_size), (number), (remaining_size))
+#define json_tkv_float(buf, lit, number, remaining_size)                       \
+  json_float(JSON_KEY(buf, lit, remaining_size), (number), (remaining_size))
+#define json_tkv_double_fixed(buf, lit, number, precision, remaining_size)     \
+  json_double_fixed(JSON_KEY(buf, lit, remaining_size), (number), (precision), \
+                    (remaining_size))
+#define json_tkv_bool(buf, lit, boolean, remaining_size)                       \
+  json_bool(JSON_KEY(buf, lit, remaining_size), (boolean), (remaining_size))
+#define json_tkv_null(buf, lit, remaining_size)                                \
+  json_null(JSON_KEY(buf, lit, remaining_size), (remaining_size))
+
+/**
+ * @brief Keys of an object rendered once, for objects of the same shape.
+ *
+ * Every key is escaped when the template is built, writing a key is then a
+ * single copy.
+ */
+typedef struct {
+  /** {"key0":,"key1":,"key2": back to back. */
+  const char *fragments;
+  /** Start of every fragment in fragments, count + 1 entries. */
+  const size_t *offsets;
+  /** Number of keys. */
+  size_t count;
+} json_template_t;
+
+/**
+ * @brief Worst case fragments size for count keys of total_len bytes.
+ */
+#define JSON_TEMPLATE_FRAGMENTS_SIZE(count, total_len)                         \
+  (6 * (total_len) + 4 * (count) + 1)
+
+/**
+ * @brief Render the keys of an object.
+ *
+ * @param tpl template to initialize.
+ * @param keys object keys, in the order they are written.
+ * @param count number of keys.
+ * @param fragments storage for the rendered keys, used by the template.
+ * @param fragments_size size of fragments.
+ * @param offsets storage for count + 1 offsets, used by the template.
+ *
+ * @return 0 on success, -1 if fragments is too small.
+ */
+int json_template_init(json_template_t *tpl, const char *const *keys,
+                       size_t count, char *fragments, size_t fragments_size,
+                       size_t *offsets);
+
+/**
+ * @brief Open an object and write its first key, {"key0":
+ *
+ * @param buf json write-out buffer.
+ * @param tpl object template.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer.
+ */
+char *json_template_open(char *buf, const json_template_t *tpl,
+                         size_t *remaining_size);
+
+/**
+ * @brief Write a key of the template, "keyN":
+ *
+ * @param buf json write-out buffer.
+ * @param tpl object template.
+ * @param field index of the key in the template.
+ * @param remaining_size buf remaining size.
+ *
+ * @return pointer to the end of the new json-write out buffer, NULL if field
+ * is out of range.
+ */
+char *json_template_key(char *buf, const json_template_t *tpl, size_t field,
+                        size_t *remaining_size);
+
 char *json_end(char *buf, size_t *remaining_size);
 
+/**
+ * @brief Implementation used to find the characters to escape in strings.
+ *
+ * Every backend gives the same output, JSON_ESCAPE_AUTO picks the fastest one
+ * supported by the running cpu.
+ */
+typedef enum {
+  JSON_ESCAPE_AUTO,
+  JSON_ESCAPE_SCALAR,
+  JSON_ESCAPE_SWAR,
+  JSON_ESCAPE_SSE2,
+  JSON_ESCAPE_AVX2,
+  JSON_ESCAPE_NEON,
+} json_escape_backend_t;
+
+/**
+ * @brief Select the string escaping backend.
+ *
+ * The default is set at build time with the escape_backend meson option.
+ *
+ * @param backend backend to use.
+ *
+ * @return 0 on success, -1 if the backend is not available on this target.
+ */
+int json_escape_backend_set(json_escape_backend_t backend);
+
+/**
+ * @brief Get the string escaping backend in use.
+ */
+json_escape_backend_t json_escape_backend_get(void);
+
 #endif /* ifndef JSON_SERIALIZER_H_ */
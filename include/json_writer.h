@@ -0,0 +1,492 @@
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#endif
+
+#include "json_serializer.h"
+
+/**
+ * @brief JSON Writer header.
+ *
+ * The writer keeps the output buffer and the error state in a context, every
+ * function writes at the cursor and none of them has to be checked: after the
+ * first error the writer ignores the following calls and json_writer_finish()
+ * reports it.
+ */
+
+/**
+ * @brief Writer errors, the first one is kept.
+ */
+typedef enum {
+  JSON_OK = 0,
+  /** The output buffer is full. */
+  JSON_ERR_NO_SPACE,
+  /** A string holds an invalid or truncated utf-8 sequence. */
+  JSON_ERR_UTF8,
+  /** Invalid argument, such as a template field out of range. */
+  JSON_ERR_INVALID,
+  /**
+   * Close without matching open, member without key, unclosed value, or a
+   * second root value.
+   */
+  JSON_ERR_NESTING,
+  /** More than JSON_WRITER_MAX_DEPTH objects and arrays open. */
+  JSON_ERR_DEPTH,
+  /** The flush callback of a stream writer failed. */
+  JSON_ERR_FLUSH,
+  /** The allocator of a growable writer failed. */
+  JSON_ERR_ALLOC,
+} json_error_t;
+
+/**
+ * @brief Stream writer output, called each time the chunk is full and by
+ * json_writer_finish().
+ *
+ * @param ctx context given to json_writer_init_stream().
+ * @param data bytes of the document, not null terminated.
+ * @param len number of bytes in data, never 0.
+ *
+ * @return 0 on success, anything else stops the writer with JSON_ERR_FLUSH.
+ */
+typedef int (*json_flush_fn)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Iovec writer output entry, struct iovec where it exists so the array
+ * can be given to writev() or sendmsg().
+ */
+#if defined(__unix__) || defined(__APPLE__)
+typedef struct iovec json_iovec_t;
+#else
+typedef struct {
+  void *iov_base;
+  size_t iov_len;
+} json_iovec_t;
+#endif
+
+/**
+ * @brief Growable writer allocator, one function like realloc() and free().
+ *
+ * @param ctx context given to json_writer_init_growable(), such as an arena.
+ * @param ptr block to resize, NULL to allocate a new one.
+ * @param old_size size of ptr, 0 when ptr is NULL.
+ * @param new_size size wanted, 0 to free ptr.
+ *
+ * @return the resized block with its first old_size bytes kept, NULL on
+ * failure or when freeing.
+ */
+typedef void *(*json_resize_fn)(void *ctx, void *ptr, size_t old_size,
+                                size_t new_size);
+
+/**
+ * @brief Writer options, see json_writer_set_options().
+ */
+typedef enum {
+  /**
+   * Write ',' after every value and remove it when closing, like the
+   * buf/remaining_size functions. Nesting is not tracked in this mode.
+   */
+  JSON_WRITER_TRAILING_COMMA = 1 << 0,
+  /**
+   * Copy valid utf-8 as is instead of writing \uXXXX escapes, non-ascii
+   * text is up to 3 times smaller. Invalid sequences set JSON_ERR_UTF8.
+   */
+  JSON_WRITER_UTF8_RAW = 1 << 1,
+  /** With JSON_WRITER_UTF8_RAW, copy bytes from 0x80 without validating. */
+  JSON_WRITER_UTF8_UNCHECKED = 1 << 2,
+  /** Copy '/' as is, it does not need the "\/" escape. */
+  JSON_WRITER_SOLIDUS_RAW = 1 << 3,
+  /**
+   * Copy the control characters below 0x20 as is. The output is not valid
+   * json anymore, only for readers accepting them.
+   */
+  JSON_WRITER_CONTROL_RAW = 1 << 4,
+} json_writer_option_t;
+
+/** Most objects and arrays open at once, one bit each in the nesting stack. */
+#define JSON_WRITER_MAX_DEPTH 64
+
+/**
+ * Smallest chunk of a stream writer, numbers and separators are never split
+ * across two flushes.
+ */
+#define JSON_WRITER_MIN_CHUNK 32
+
+/**
+ * Shortest run of plain string bytes an iovec writer references in place,
+ * shorter ones are cheaper to copy than an iovec entry.
+ */
+#define JSON_WRITER_IOV_MIN_REF 64
+
+/**
+ * @brief Token types counted by the writer statistics.
+ */
+typedef enum {
+  JSON_TOKEN_OBJECT,
+  JSON_TOKEN_ARRAY,
+  JSON_TOKEN_KEY,
+  JSON_TOKEN_STRING,
+  JSON_TOKEN_NUMBER,
+  JSON_TOKEN_BOOL,
+  JSON_TOKEN_NULL,
+  JSON_TOKEN_RAW,
+  JSON_TOKEN_BINARY,
+  JSON_TOKEN_COUNT,
+} json_token_t;
+
+/**
+ * @brief Writer statistics, see json_writer_stats().
+ *
+ * Only counted when built with JSON_WRITER_STATS (meson stats option), the
+ * counters compile to nothing otherwise. The member is always in
+ * json_writer_t, its layout does not depend on the build options.
+ */
+typedef struct {
+  /** Bytes of the document so far, flushed ones included. */
+  size_t bytes;
+  /** Tokens written per json_token_t, array elements included. */
+  size_t tokens[JSON_TOKEN_COUNT];
+  /** Characters written as an escape sequence, short or \\u. */
+  size_t escapes;
+  /** Of those, utf-8 sequences written as \\u escapes. */
+  size_t unicode;
+  /** Most objects and arrays open at once. */
+  unsigned int peak_depth;
+  /** Document length when the buffer ran out, with JSON_ERR_NO_SPACE. */
+  size_t overflow_offset;
+} json_writer_stats_t;
+
+/**
+ * @brief Writer context.
+ */
+typedef struct {
+  /** First byte of the output. */
+  char *start;
+  /** Next byte to write. */
+  char *cursor;
+  /** Last byte of the output buffer, kept for the null byte. */
+  char *end;
+  /** First error, JSON_OK if none. */
+  json_error_t error;
+  /** Number of objects and arrays open. */
+  unsigned int depth;
+  /** Bit i set when container i + 1 is an object, clear for an array. */
+  uint64_t nesting;
+  /** Position in the current container, first element or after a key. */
+  unsigned int state;
+  /** json_writer_option_t flags. */
+  unsigned int options;
+  /** Stream output, NULL when writing to a single buffer. */
+  json_flush_fn flush;
+  void *flush_ctx;
+  /** Bytes out of the buffer: flushed, measured, or referenced by iov. */
+  size_t flushed;
+  /** Growable buffer allocator, NULL when the buffer belongs to the caller. */
+  json_resize_fn resize;
+  void *resize_ctx;
+  /** Size of the buffer, the null byte included. */
+  size_t capacity;
+  /** Count the bytes in flushed, write nothing. */
+  int measure;
+  /** Iovec output, NULL when not used. */
+  json_iovec_t *iov;
+  size_t iov_count;
+  size_t iov_used;
+  /** Staging bytes not in an iovec entry yet start here. */
+  char *segment;
+  /** Left untouched when not built with JSON_WRITER_STATS. */
+  json_writer_stats_t stats;
+} json_writer_t;
+
+/**
+ * @brief Initialize a writer on a buffer.
+ *
+ * @param w writer.
+ * @param buf json write-out buffer.
+ * @param size size of buf, including the null byte.
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t size);
+
+/**
+ * @brief Initialize a writer on a chunk drained to a callback.
+ *
+ * The document is written to buf and handed to flush whenever buf is full,
+ * memory use does not depend on the document size. Strings and keys longer
+ * than the chunk are split across flushes. Not for use with
+ * JSON_WRITER_TRAILING_COMMA, a flushed ',' cannot be removed.
+ *
+ * @param w writer.
+ * @param buf chunk, its last byte is scratch space and never flushed.
+ * @param size size of buf, at least JSON_WRITER_MIN_CHUNK.
+ * @param flush output callback.
+ * @param ctx passed to flush.
+ */
+void json_writer_init_stream(json_writer_t *w, char *buf, size_t size,
+                             json_flush_fn flush, void *ctx);
+
+/**
+ * @brief Initialize a writer that outputs an iovec array.
+ *
+ * Separators, numbers and short strings are copied to the staging buffer,
+ * runs of at least JSON_WRITER_IOV_MIN_REF bytes of strings and trusted keys
+ * that need no escape are referenced where they are. After
+ * json_writer_finish() the first json_writer_iov_count() entries of iov hold
+ * the document, without null byte; the strings must stay valid until then.
+ * Not for use with JSON_WRITER_TRAILING_COMMA.
+ *
+ * @param w writer.
+ * @param buf staging buffer, its last byte is scratch space.
+ * @param size size of buf.
+ * @param iov output entries, pointing into buf or the caller strings.
+ * @param iov_count number of entries in iov.
+ */
+void json_writer_init_iovec(json_writer_t *w, char *buf, size_t size,
+                            json_iovec_t *iov, size_t iov_count);
+
+/**
+ * @brief Number of iov entries used by an iovec writer.
+ */
+size_t json_writer_iov_count(const json_writer_t *w);
+
+/**
+ * @brief Initialize a writer that only counts bytes.
+ *
+ * The same calls as for the real document give its exact length with
+ * json_writer_length(), escapes included, and nothing is stored: the buffer
+ * needed is that length plus the null byte. Not for use with
+ * JSON_WRITER_TRAILING_COMMA.
+ *
+ * @param w writer.
+ */
+void json_writer_init_measure(json_writer_t *w);
+
+/**
+ * @brief Initialize a writer on a buffer it allocates and grows.
+ *
+ * The capacity doubles when a token does not fit, nothing is serialized
+ * twice. Get the document with json_writer_release() or free it with
+ * json_writer_dispose().
+ *
+ * @param w writer.
+ * @param size initial capacity, at least JSON_WRITER_MIN_CHUNK is allocated.
+ * @param resize allocator, NULL for realloc() and free().
+ * @param ctx passed to resize.
+ */
+void json_writer_init_growable(json_writer_t *w, size_t size,
+                               json_resize_fn resize, void *ctx);
+
+/**
+ * @brief Take the buffer of a growable writer, after json_writer_finish().
+ *
+ * The buffer is not copied, the caller frees it with the writer allocator and
+ * the writer cannot be used anymore. json_writer_finish() then returns JSON_OK
+ * and writes nothing, a token written after the release fails.
+ *
+ * @param w writer.
+ * @param size size of the allocated buffer, not the document length.
+ *
+ * @return the null terminated document, NULL on error or if the writer is not
+ * growable.
+ */
+char *json_writer_release(json_writer_t *w, size_t *size);
+
+/**
+ * @brief Free the buffer of a growable writer, if it was not released.
+ */
+void json_writer_dispose(json_writer_t *w);
+
+/**
+ * @brief Set the json_writer_option_t flags, before the first write.
+ */
+void json_writer_set_options(json_writer_t *w, unsigned int options);
+
+/**
+ * @brief Close json. (write the null byte)
+ *
+ * Commas are only written in front of the next element, nothing has to be
+ * removed.
+ *
+ * @param w writer.
+ *
+ * A stream writer flushes what is left of the chunk instead, no null byte is
+ * written.
+ *
+ * @return JSON_OK, JSON_ERR_NESTING if an object or array is still open, or
+ * the first error of the writer.
+ */
+json_error_t json_writer_finish(json_writer_t *w);
+
+/**
+ * @brief Number of bytes written, without the null byte, flushed ones
+ * included.
+ */
+size_t json_writer_length(const json_writer_t *w);
+
+/**
+ * @brief Copy the statistics of the writer, to export them.
+ *
+ * Peak depth is not tracked with JSON_WRITER_TRAILING_COMMA.
+ *
+ * @param w writer.
+ * @param stats filled with the counters, zeroed when not built with
+ * JSON_WRITER_STATS.
+ *
+ * @return 0, or -1 when not built with JSON_WRITER_STATS.
+ */
+int json_writer_stats(const json_writer_t *w, json_writer_stats_t *stats);
+
+/**
+ * @brief Open a json object.
+ *
+ * @param w writer.
+ * @param name object key, NULL for unnamed object.
+ */
+void json_writer_obj_open(json_writer_t *w, const char *name);
+
+/**
+ * @brief Close a json object.
+ */
+void json_writer_obj_close(json_writer_t *w);
+
+/**
+ * @brief Open a json array.
+ *
+ * @param w writer.
+ * @param name object key, NULL for unnamed object.
+ */
+void json_writer_arr_open(json_writer_t *w, const char *name);
+
+/**
+ * @brief Close a json array.
+ */
+void json_writer_arr_close(json_writer_t *w);
+
+void json_writer_true(json_writer_t *w);
+void json_writer_false(json_writer_t *w);
+void json_writer_bool(json_writer_t *w, int boolean);
+void json_writer_null(json_writer_t *w);
+
+void json_writer_str(json_writer_t *w, const char *str);
+
+/**
+ * @brief Same as json_strn().
+ */
+void json_writer_strn(json_writer_t *w, const char *str, size_t len);
+
+void json_writer_number(json_writer_t *w, long number);
+void json_writer_int64(json_writer_t *w, int64_t number);
+void json_writer_uint64(json_writer_t *w, uint64_t number);
+void json_writer_int32(json_writer_t *w, int32_t number);
+
+/**
+ * @brief Same as json_raw(), json is referenced in place by an iovec writer.
+ */
+void json_writer_raw(json_writer_t *w, const char *json, size_t len);
+
+/**
+ * @brief Same as json_arr_int32(), json_arr_double() and json_arr_bool().
+ */
+void json_writer_arr_int32(json_writer_t *w, const char *name,
+                           const int32_t *values, size_t count);
+void json_writer_arr_double(json_writer_t *w, const char *name,
+                            const double *values, size_t count);
+void json_writer_arr_bool(json_writer_t *w, const char *name,
+                          const int *values, size_t count);
+
+/**
+ * @brief Same as json_base64() and json_hex().
+ */
+void json_writer_base64(json_writer_t *w, const void *data, size_t len);
+void json_writer_hex(json_writer_t *w, const void *data, size_t len);
+
+/**
+ * @brief Same as json_double(), json_float() and json_double_fixed().
+ */
+void json_writer_double(json_writer_t *w, double number);
+void json_writer_float(json_writer_t *w, float number);
+void json_writer_double_fixed(json_writer_t *w, double number,
+                              unsigned int precision);
+
+/**
+ * @brief Same as json_key() and json_key_trusted().
+ */
+void json_writer_key(json_writer_t *w, const char *name);
+void json_writer_key_trusted(json_writer_t *w, const char *name, size_t len);
+
+/**
+ * @brief Write a "name":value member of an object, see json_kv_str().
+ */
+void json_writer_kv_str(json_writer_t *w, const char *name, const char *str);
+void json_writer_kv_strn(json_writer_t *w, const char *name, const char *str,
+                         size_t len);
+void json_writer_kv_number(json_writer_t *w, const char *name, long number);
+void json_writer_kv_int64(json_writer_t *w, const char *name, int64_t number);
+void json_writer_kv_uint64(json_writer_t *w, const char *name,
+                           uint64_t number);
+void json_writer_kv_int32(json_writer_t *w, const char *name, int32_t number);
+void json_writer_kv_double(json_writer_t *w, const char *name, double number);
+void json_writer_kv_float(json_writer_t *w, const char *name, float number);
+void json_writer_kv_double_fixed(json_writer_t *w, const char *name,
+                                 double number, unsigned int precision);
+void json_writer_kv_bool(json_writer_t *w, const char *name, int boolean);
+void json_writer_kv_null(json_writer_t *w, const char *name);
+void json_writer_kv_base64(json_writer_t *w, const char *name,
+                           const void *data, size_t len);
+void json_writer_kv_hex(json_writer_t *w, const char *name, const void *data,
+                        size_t len);
+void json_writer_kv_raw(json_writer_t *w, const char *name, const char *json,
+                        size_t len);
+
+/**
+ * @brief Key from a string literal, see JSON_KEY().
+ */
+#define JSON_WRITER_KEY(w, lit)                                                \
+  json_writer_key_trusted((w), "" lit, sizeof(lit) - 1)
+
+/**
+ * @brief Make room for len bytes, written next by the unchecked emitters.
+ *
+ * A stream writer drains its chunk first and a growable writer grows. Bound
+ * len with the JSON_MAX_LEN_* macros, one more byte per token for its ','.
+ *
+ * @return 1 if the next len bytes can be written without checks, 0 if they
+ * do not fit, on error or when measuring. The checked emitters have to be
+ * used then, the actual tokens may still fit. Running out of room is not an
+ * error here, only a failed flush or reallocation is.
+ */
+int json_writer_reserve(json_writer_t *w, size_t len);
+
+/**
+ * @brief Same as the checked emitters, without any capacity check.
+ *
+ * Only within the room made by the last json_writer_reserve() returning 1.
+ * Separators and nesting are still tracked.
+ */
+void json_writer_bool_unchecked(json_writer_t *w, int boolean);
+void json_writer_null_unchecked(json_writer_t *w);
+void json_writer_int64_unchecked(json_writer_t *w, int64_t number);
+void json_writer_uint64_unchecked(json_writer_t *w, uint64_t number);
+void json_writer_int32_unchecked(json_writer_t *w, int32_t number);
+void json_writer_double_unchecked(json_writer_t *w, double number);
+void json_writer_float_unchecked(json_writer_t *w, float number);
+void json_writer_key_trusted_unchecked(json_writer_t *w, const char *name,
+                                       size_t len);
+
+/**
+ * @brief Unchecked key from a string literal, see JSON_WRITER_KEY().
+ */
+#define JSON_WRITER_KEY_UNCHECKED(w, lit)                                      \
+  json_writer_key_trusted_unchecked((w), "" lit, sizeof(lit) - 1)
+
+/**
+ * @brief Same as json_template_open() and json_template_key().
+ */
+void json_writer_template_open(json_writer_t *w, const json_template_t *tpl);
+void json_writer_template_key(json_writer_t *w, const json_template_t *tpl,
+                              size_t field);
+
+#endif /* ifndef JSON_WRITER_H_ */
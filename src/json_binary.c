@@ -0,0 +1,61 @@
+#include "json_binary.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static const char base64_alphabet[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/** "00" "01" ... "ff", one lookup per input byte. */
+static const char hex_pairs[512] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+void json_base64_encode(char *out, const unsigned char *data, size_t len) {
+  const unsigned char *end = data + len - len % 3;
+
+  /* 3 bytes to 4 characters, one lookup per 6 bits */
+  for (; data < end; data += 3, out += 4) {
+    unsigned long bits = (unsigned long)data[0] << 16 |
+                         (unsigned long)data[1] << 8 | data[2];
+
+    out[0] = base64_alphabet[(bits >> 18) & 0x3F];
+    out[1] = base64_alphabet[(bits >> 12) & 0x3F];
+    out[2] = base64_alphabet[(bits >> 6) & 0x3F];
+    out[3] = base64_alphabet[bits & 0x3F];
+  }
+
+  switch (len % 3) {
+  case 1:
+    out[0] = base64_alphabet[data[0] >> 2];
+    out[1] = base64_alphabet[(data[0] & 0x03) << 4];
+    out[2] = '=';
+    out[3] = '=';
+    break;
+  case 2:
+    out[0] = base64_alphabet[data[0] >> 2];
+    out[1] = base64_alphabet[(data[0] & 0x03) << 4 | data[1] >> 4];
+    out[2] = base64_alphabet[(data[1] & 0x0F) << 2];
+    out[3] = '=';
+    break;
+  }
+}
+
+void json_hex_encode(char *out, const unsigned char *data, size_t len) {
+  for (size_t i = 0; i < len; ++i)
+    memcpy(out + 2 * i, hex_pairs + 2 * data[i], 2);
+}
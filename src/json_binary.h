@@ -0,0 +1,34 @@
+#ifndef JSON_BINARY_H_
+#define JSON_BINARY_H_
+
+#include <stddef.h>
+
+/**
+ * @brief Internal binary to text encoders shared by the serializer.
+ *
+ * Neither alphabet has a character to escape in a json string.
+ */
+
+/**
+ * @brief Length of the base64 encoding of len bytes, padding included.
+ */
+static inline size_t json_base64_len(size_t len) { return (len + 2) / 3 * 4; }
+
+/**
+ * @brief Write the base64 encoding (RFC 4648, padded) of [data, data + len).
+ *
+ * Encoding consecutive blocks whose length is a multiple of 3 gives the same
+ * output as encoding everything at once.
+ *
+ * @param out at least json_base64_len(len) bytes.
+ */
+void json_base64_encode(char *out, const unsigned char *data, size_t len);
+
+/**
+ * @brief Write the lowercase hexadecimal form of [data, data + len).
+ *
+ * @param out at least 2 * len bytes.
+ */
+void json_hex_encode(char *out, const unsigned char *data, size_t len);
+
+#endif /* ifndef JSON_BINARY_H_ */
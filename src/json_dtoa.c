@@ -0,0 +1,383 @@
+#include "json_dtoa.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "json_number.h"
+
+/*
+ * Shortest round-trip formatting with the Grisu2 algorithm (Florian Loitsch,
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers").
+ * The output always parses back to the same value and is the shortest one
+ * for almost every input. Only integer arithmetic is used, no libc call.
+ */
+
+/**
+ * @brief Floating point number f * 2^e with a 64-bit significand.
+ */
+typedef struct {
+  uint64_t f;
+  int e;
+} diy_fp;
+
+/**
+ * @brief Normalized 10^(-348 + 8 * i) for i in [0, 87).
+ */
+static const struct {
+  uint64_t f;
+  int16_t e;
+} cached_powers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166},
+    {0xcf42894a5dce35eaULL, -1140}, {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034}, {0xbe5691ef416bd60cULL, -1007},
+    {0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+    {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847},
+    {0xc21094364dfb5637ULL, -821}, {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+    {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715}, {0xb23867fb2a35b28eULL, -688},
+    {0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+    {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529},
+    {0xb5b5ada8aaff80b8ULL, -502}, {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+    {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396}, {0xa6dfbd9fb8e5b88fULL, -369},
+    {0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+    {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210},
+    {0xaa242499697392d3ULL, -183}, {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+    {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77}, {0x9c40000000000000ULL, -50},
+    {0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+    {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109},
+    {0x9f4f2726179a2245ULL, 136}, {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+    {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242}, {0x924d692ca61be758ULL, 269},
+    {0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+    {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428},
+    {0x952ab45cfa97a0b3ULL, 455}, {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+    {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561}, {0x88fcf317f22241e2ULL, 588},
+    {0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+    {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747},
+    {0x8bab8eefb6409c1aULL, 774}, {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+    {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880}, {0x80444b5e7aa7cf85ULL, 907},
+    {0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+    {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+static const uint32_t pow10_u32[] = {1,      10,      100,      1000,
+                                     10000,  100000,  1000000,  10000000,
+                                     100000000, 1000000000};
+
+static diy_fp diy_fp_sub(diy_fp x, diy_fp y) {
+  diy_fp r = {x.f - y.f, x.e};
+  return r;
+}
+
+/**
+ * @brief Upper 64 bits of the 128-bit product, rounded.
+ */
+static diy_fp diy_fp_mul(diy_fp x, diy_fp y) {
+  const uint64_t mask32 = 0xFFFFFFFFu;
+  uint64_t a = x.f >> 32, b = x.f & mask32;
+  uint64_t c = y.f >> 32, d = y.f & mask32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & mask32) + (bc & mask32);
+
+  tmp += (uint64_t)1 << 31;
+
+  diy_fp r = {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+  return r;
+}
+
+static diy_fp diy_fp_normalize(diy_fp x) {
+  while (!(x.f & ((uint64_t)1 << 63))) {
+    x.f <<= 1;
+    --x.e;
+  }
+
+  return x;
+}
+
+/**
+ * @brief Value of significand * 2^exponent and its rounding boundaries.
+ *
+ * @param significand significand with the hidden bit.
+ * @param hidden_bit hidden bit of the format, 2^52 for double, 2^23 for float.
+ * @param bits number of explicit significand bits, 52 or 23.
+ */
+static void boundaries(diy_fp v, uint64_t hidden_bit, int bits, diy_fp *minus,
+                       diy_fp *plus) {
+  diy_fp pl = {(v.f << 1) + 1, v.e - 1};
+
+  while (!(pl.f & (hidden_bit << 1))) {
+    pl.f <<= 1;
+    --pl.e;
+  }
+  pl.f <<= 64 - bits - 2;
+  pl.e -= 64 - bits - 2;
+
+  /* the lower boundary is closer for powers of two */
+  diy_fp mi;
+  if (v.f == hidden_bit) {
+    mi.f = (v.f << 2) - 1;
+    mi.e = v.e - 2;
+  } else {
+    mi.f = (v.f << 1) - 1;
+    mi.e = v.e - 1;
+  }
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+
+  *minus = mi;
+  *plus = pl;
+}
+
+/**
+ * @brief Cached power c such that the product with 2^e has an exponent in
+ * [-60, -32], sets K so that c is 10^-K.
+ */
+static diy_fp cached_power(int e, int *K) {
+  /* ceil((-61 - e) * log10(2)) + 347, log10(2) in 32.32 fixed point */
+  int64_t dk = (int64_t)(-61 - e) * 1292913986;
+  int k = (int)(dk >> 32) + 347 + ((dk & 0xFFFFFFFF) != 0);
+  unsigned int index = (unsigned int)((k >> 3) + 1);
+
+  *K = -(-348 + (int)index * 8);
+
+  diy_fp r = {cached_powers[index].f, cached_powers[index].e};
+  return r;
+}
+
+static void grisu_round(char *digits, int len, uint64_t delta, uint64_t rest,
+                        uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    --digits[len - 1];
+    rest += ten_kappa;
+  }
+}
+
+static unsigned int u32_len(uint32_t value) {
+  unsigned int len = 1;
+
+  while (len < 10 && value >= pow10_u32[len])
+    ++len;
+
+  return len;
+}
+
+static int digit_gen(diy_fp W, diy_fp Mp, uint64_t delta, char *digits,
+                     int *K) {
+  const diy_fp one = {(uint64_t)1 << -Mp.e, Mp.e};
+  const diy_fp wp_w = diy_fp_sub(Mp, W);
+  uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+  uint64_t p2 = Mp.f & (one.f - 1);
+  int kappa = (int)u32_len(p1);
+  int len = 0;
+
+  while (kappa > 0) {
+    uint32_t d = p1 / pow10_u32[kappa - 1];
+    p1 %= pow10_u32[kappa - 1];
+
+    if (d || len)
+      digits[len++] = (char)('0' + d);
+
+    --kappa;
+
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *K += kappa;
+      grisu_round(digits, len, delta, rest,
+                  (uint64_t)pow10_u32[kappa] << -one.e, wp_w.f);
+      return len;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+
+    char d = (char)(p2 >> -one.e);
+    if (d || len)
+      digits[len++] = (char)('0' + d);
+
+    p2 &= one.f - 1;
+    --kappa;
+
+    if (p2 < delta) {
+      *K += kappa;
+      int index = -kappa;
+      grisu_round(digits, len, delta, p2, one.f,
+                  wp_w.f * (index < 10 ? pow10_u32[index] : 0));
+      return len;
+    }
+  }
+}
+
+static int grisu2(diy_fp v, uint64_t hidden_bit, int bits, char *digits,
+                  int *K) {
+  diy_fp w_m, w_p;
+  boundaries(v, hidden_bit, bits, &w_m, &w_p);
+
+  const diy_fp c_mk = cached_power(w_p.e, K);
+  const diy_fp W = diy_fp_mul(diy_fp_normalize(v), c_mk);
+  diy_fp Wp = diy_fp_mul(w_p, c_mk);
+  diy_fp Wm = diy_fp_mul(w_m, c_mk);
+
+  ++Wm.f;
+  --Wp.f;
+
+  return digit_gen(W, Wp, Wp.f - Wm.f, digits, K);
+}
+
+static size_t write_exponent(char *out, int exponent) {
+  char *cur = out;
+
+  if (exponent < 0) {
+    *cur++ = '-';
+    exponent = -exponent;
+  }
+
+  unsigned int len = json_u64_len((uint64_t)exponent);
+  json_u64_write(cur, (uint64_t)exponent, len);
+
+  return (size_t)(cur - out) + len;
+}
+
+/**
+ * @brief Lay out len digits of value digits * 10^k.
+ *
+ * Plain notation for exponents in [-6, 21), the digits are moved in place.
+ */
+static size_t prettify(char *out, int len, int k) {
+  /* 10^(kk - 1) <= value < 10^kk */
+  const int kk = len + k;
+
+  if (k >= 0 && kk <= 21) {
+    /* 1234e7 -> 12340000000.0 */
+    memset(out + len, '0', (size_t)(kk - len));
+    out[kk] = '.';
+    out[kk + 1] = '0';
+    return (size_t)kk + 2;
+  }
+
+  if (kk > 0 && kk <= 21) {
+    /* 1234e-2 -> 12.34 */
+    memmove(out + kk + 1, out + kk, (size_t)(len - kk));
+    out[kk] = '.';
+    return (size_t)len + 1;
+  }
+
+  if (kk > -6 && kk <= 0) {
+    /* 1234e-6 -> 0.001234 */
+    const int offset = 2 - kk;
+    memmove(out + offset, out, (size_t)len);
+    out[0] = '0';
+    out[1] = '.';
+    memset(out + 2, '0', (size_t)(offset - 2));
+    return (size_t)(len + offset);
+  }
+
+  if (len == 1) {
+    /* 1e30 */
+    out[1] = 'e';
+    return 2 + write_exponent(out + 2, kk - 1);
+  }
+
+  /* 1234e30 -> 1.234e33 */
+  memmove(out + 2, out + 1, (size_t)(len - 1));
+  out[1] = '.';
+  out[len + 1] = 'e';
+  return (size_t)len + 2 + write_exponent(out + len + 2, kk - 1);
+}
+
+/**
+ * @brief Common part of the double and float formatting.
+ *
+ * @param significand explicit significand bits.
+ * @param biased_exponent exponent field, all ones for NaN and infinity.
+ */
+static size_t format(char *out, int negative, uint64_t significand,
+                     int biased_exponent, int bits, int exponent_bias,
+                     int max_exponent) {
+  const uint64_t hidden_bit = (uint64_t)1 << bits;
+  char *cur = out;
+
+  /* not representable in json */
+  if (biased_exponent == max_exponent) {
+    memcpy(out, "null", 4);
+    return 4;
+  }
+
+  if (negative)
+    *cur++ = '-';
+
+  if (biased_exponent == 0 && significand == 0) {
+    memcpy(cur, "0.0", 3);
+    return (size_t)(cur - out) + 3;
+  }
+
+  diy_fp v;
+  if (biased_exponent) {
+    v.f = significand + hidden_bit;
+    v.e = biased_exponent - exponent_bias - bits;
+  } else {
+    /* subnormal */
+    v.f = significand;
+    v.e = 1 - exponent_bias - bits;
+  }
+
+  int K = 0;
+  int len = grisu2(v, hidden_bit, bits, cur, &K);
+
+  return (size_t)(cur - out) + prettify(cur, len, K);
+}
+
+size_t json_dtoa(char *out, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  return format(out, (int)(bits >> 63), bits & (((uint64_t)1 << 52) - 1),
+                (int)((bits >> 52) & 0x7FF), 52, 1023, 0x7FF);
+}
+
+size_t json_ftoa(char *out, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  return format(out, (int)(bits >> 31), bits & (((uint32_t)1 << 23) - 1),
+                (int)((bits >> 23) & 0xFF), 23, 127, 0xFF);
+}
+
+size_t json_dtoa_fixed(char *out, double value, unsigned int precision) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  if (precision > JSON_DOUBLE_MAX_PRECISION)
+    precision = JSON_DOUBLE_MAX_PRECISION;
+
+  const uint64_t scale = precision ? json_powers_of_10[precision] : 1;
+  double magnitude = value < 0 ? -value : value;
+  double scaled = magnitude * (double)scale + 0.5;
+
+  /* NaN, infinity and values not fitting in 64 bits after scaling */
+  if (((bits >> 52) & 0x7FF) == 0x7FF || !(scaled < 18446744073709551616.0))
+    return json_dtoa(out, value);
+
+  uint64_t fixed = (uint64_t)scaled;
+  uint64_t integer = fixed / scale;
+  uint64_t fraction = fixed % scale;
+  char *cur = out;
+
+  if ((bits >> 63) && fixed)
+    *cur++ = '-';
+
+  unsigned int len = json_u64_len(integer);
+  json_u64_write(cur, integer, len);
+  cur += len;
+
+  if (precision) {
+    *cur++ = '.';
+    /* leading zeros of the fraction */
+    len = json_u64_len(fraction);
+    memset(cur, '0', precision - len);
+    json_u64_write(cur + precision - len, fraction, len);
+    cur += precision;
+  }
+
+  return (size_t)(cur - out);
+}
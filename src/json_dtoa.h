@@ -0,0 +1,46 @@
+#ifndef JSON_DTOA_H_
+#define JSON_DTOA_H_
+
+#include <stddef.h>
+
+/**
+ * @brief Internal floating point formatting helpers shared by the serializer.
+ */
+
+/** Longest output, "-0.0000012345678901234567" or "-1.2345678901234567e-308". */
+#define JSON_DOUBLE_MAX_LEN 25
+
+/** Most digits after the decimal point in fixed precision mode. */
+#define JSON_DOUBLE_MAX_PRECISION 9
+
+/** Longest output in fixed precision mode, 20 integer digits and 9 decimals. */
+#define JSON_DOUBLE_FIXED_MAX_LEN (1 + 20 + 1 + JSON_DOUBLE_MAX_PRECISION)
+
+/**
+ * @brief Write the shortest representation parsing back to value.
+ *
+ * NaN and infinity are written as null.
+ *
+ * @param out at least JSON_DOUBLE_MAX_LEN bytes.
+ *
+ * @return number of bytes written.
+ */
+size_t json_dtoa(char *out, double value);
+
+/**
+ * @brief Same as json_dtoa() with the precision of a float.
+ */
+size_t json_ftoa(char *out, float value);
+
+/**
+ * @brief Write value rounded to precision digits after the decimal point.
+ *
+ * Falls back to json_dtoa() when the scaled value does not fit in 64 bits.
+ *
+ * @param out at least JSON_DOUBLE_FIXED_MAX_LEN bytes.
+ *
+ * @return number of bytes written.
+ */
+size_t json_dtoa_fixed(char *out, double value, unsigned int precision);
+
+#endif /* ifndef JSON_DTOA_H_ */
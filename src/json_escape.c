@@ -0,0 +1,321 @@
+#include "json_escape.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_HAVE_SSE2 1
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define JSON_HAVE_AVX2 1
+#endif
+#endif
+
+#if defined(__ARM_NEON) && defined(__BYTE_ORDER__) &&                          \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define JSON_HAVE_NEON 1
+#endif
+
+#ifndef JSON_ESCAPE_DEFAULT_BACKEND
+#define JSON_ESCAPE_DEFAULT_BACKEND JSON_ESCAPE_AUTO
+#endif
+
+const char json_escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '/',
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+};
+
+const unsigned char json_escape_len[128] = {
+    6, 6, 6, 6, 6, 6, 6, 6, 2, 2, 2, 6, 2, 2, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+/*
+ * Utf-8 decoder by Bjoern Hoehrmann, http://bjoern.hoehrmann.de/utf-8/decoder/dfa/
+ * The classes split the lead and continuation bytes by the ranges the
+ * following byte may take, which rejects overlong forms, surrogates and code
+ * points above U+10FFFF as soon as the second byte is read.
+ */
+const unsigned char json_utf8_class[256] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+    9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
+    7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+    7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+    8,  8,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+    2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+    10, 3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  4,  3,  3,
+    11, 6,  6,  6,  5,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+};
+
+const unsigned char json_utf8_transition[9 * 12] = {
+    0,  12, 24, 36, 60, 96, 84, 12, 12, 12, 48, 72, /* accept */
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, /* reject */
+    12, 0,  12, 12, 12, 12, 12, 0,  12, 0,  12, 12, /* 1 byte left */
+    12, 24, 12, 12, 12, 12, 12, 24, 12, 24, 12, 12, /* 2 bytes left */
+    12, 12, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12, /* after E0 */
+    12, 24, 12, 12, 12, 12, 12, 12, 12, 24, 12, 12, /* after ED */
+    12, 12, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12, /* after F0 */
+    12, 36, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12, /* 3 bytes left */
+    12, 36, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, /* after F4 */
+};
+
+typedef const unsigned char *(*scan_fn)(const unsigned char *str,
+                                        const unsigned char *end);
+
+/**
+ * @brief Reference backend, one table lookup per byte.
+ */
+static const unsigned char *scan_scalar(const unsigned char *str,
+                                        const unsigned char *end) {
+  while (str < end && !json_escape_table[*str])
+    ++str;
+
+  return str;
+}
+
+#define ONES ((uint64_t)0x0101010101010101)
+#define HIGHS ((uint64_t)0x8080808080808080)
+
+/**
+ * @brief Non zero when one of the 8 bytes of word may need escaping.
+ *
+ * Flags '"', '\\', '/', bytes below 0x20 and bytes with the high bit set,
+ * exactly the bytes with an entry in json_escape_table.
+ */
+static inline uint64_t swar_needs_escape(uint64_t word) {
+  uint64_t quote = word ^ (ONES * '"');
+  uint64_t rsolidus = word ^ (ONES * '\\');
+  uint64_t solidus = word ^ (ONES * '/');
+
+  uint64_t found = ((quote - ONES) & ~quote) | ((rsolidus - ONES) & ~rsolidus) |
+                   ((solidus - ONES) & ~solidus) | (word - ONES * 0x20) | word;
+
+  return found & HIGHS;
+}
+
+/**
+ * @brief 8 bytes per 64-bit word.
+ */
+static const unsigned char *scan_swar(const unsigned char *str,
+                                      const unsigned char *end) {
+  while (end - str >= 8) {
+    uint64_t word;
+    memcpy(&word, str, sizeof(word));
+
+    if (swar_needs_escape(word))
+      break;
+
+    str += 8;
+  }
+
+  return scan_scalar(str, end);
+}
+
+/*
+ * The vector backends flag '"', '\\', '/', bytes below 0x20 and bytes with the
+ * high bit set, the bytes with an entry in json_escape_table.
+ */
+
+#ifdef JSON_HAVE_SSE2
+static const unsigned char *scan_sse2(const unsigned char *str,
+                                      const unsigned char *end) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i rsolidus = _mm_set1_epi8('\\');
+  const __m128i solidus = _mm_set1_epi8('/');
+  const __m128i control = _mm_set1_epi8(0x1F);
+
+  while (end - str >= 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i *)str);
+
+    __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chars, quote),
+                                 _mm_cmpeq_epi8(chars, rsolidus));
+    found = _mm_or_si128(found, _mm_cmpeq_epi8(chars, solidus));
+    /* unsigned chars <= 0x1F, the movemask reads the high bit of the rest */
+    found = _mm_or_si128(
+        found, _mm_cmpeq_epi8(_mm_min_epu8(chars, control), chars));
+    found = _mm_or_si128(found, chars);
+
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(found);
+    if (mask)
+      return str + __builtin_ctz(mask);
+
+    str += 16;
+  }
+
+  return scan_swar(str, end);
+}
+#endif /* JSON_HAVE_SSE2 */
+
+#ifdef JSON_HAVE_AVX2
+__attribute__((target("avx2")))
+static const unsigned char *scan_avx2(const unsigned char *str,
+                                      const unsigned char *end) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i rsolidus = _mm256_set1_epi8('\\');
+  const __m256i solidus = _mm256_set1_epi8('/');
+  const __m256i control = _mm256_set1_epi8(0x1F);
+
+  while (end - str >= 32) {
+    __m256i chars = _mm256_loadu_si256((const __m256i *)str);
+
+    __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(chars, quote),
+                                    _mm256_cmpeq_epi8(chars, rsolidus));
+    found = _mm256_or_si256(found, _mm256_cmpeq_epi8(chars, solidus));
+    found = _mm256_or_si256(
+        found, _mm256_cmpeq_epi8(_mm256_min_epu8(chars, control), chars));
+    found = _mm256_or_si256(found, chars);
+
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(found);
+    if (mask)
+      return str + __builtin_ctz(mask);
+
+    str += 32;
+  }
+
+  return scan_sse2(str, end);
+}
+#endif /* JSON_HAVE_AVX2 */
+
+#ifdef JSON_HAVE_NEON
+static const unsigned char *scan_neon(const unsigned char *str,
+                                      const unsigned char *end) {
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t rsolidus = vdupq_n_u8('\\');
+  const uint8x16_t solidus = vdupq_n_u8('/');
+  const uint8x16_t control = vdupq_n_u8(0x20);
+  const uint8x16_t utf8 = vdupq_n_u8(0x80);
+
+  while (end - str >= 16) {
+    uint8x16_t chars = vld1q_u8(str);
+
+    uint8x16_t found =
+        vorrq_u8(vceqq_u8(chars, quote), vceqq_u8(chars, rsolidus));
+    found = vorrq_u8(found, vceqq_u8(chars, solidus));
+    found = vorrq_u8(found, vcltq_u8(chars, control));
+    found = vorrq_u8(found, vcgeq_u8(chars, utf8));
+
+    /* narrow every byte of the mask to a nibble */
+    uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(found), 4)), 0);
+    if (mask)
+      return str + (__builtin_ctzll(mask) >> 2);
+
+    str += 16;
+  }
+
+  return scan_swar(str, end);
+}
+#endif /* JSON_HAVE_NEON */
+
+static scan_fn backend_scan(json_escape_backend_t backend) {
+  switch (backend) {
+  case JSON_ESCAPE_SCALAR:
+    return scan_scalar;
+  case JSON_ESCAPE_SWAR:
+    return scan_swar;
+#ifdef JSON_HAVE_SSE2
+  case JSON_ESCAPE_SSE2:
+    return scan_sse2;
+#endif
+#ifdef JSON_HAVE_AVX2
+  case JSON_ESCAPE_AVX2:
+    return __builtin_cpu_supports("avx2") ? scan_avx2 : NULL;
+#endif
+#ifdef JSON_HAVE_NEON
+  case JSON_ESCAPE_NEON:
+    return scan_neon;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+/**
+ * @brief Best backend available on the running cpu.
+ */
+static json_escape_backend_t detect_backend(void) {
+  static const json_escape_backend_t preferred[] = {
+      JSON_ESCAPE_AVX2, JSON_ESCAPE_SSE2, JSON_ESCAPE_NEON, JSON_ESCAPE_SWAR};
+
+  for (size_t i = 0; i < sizeof(preferred) / sizeof(*preferred); ++i) {
+    if (backend_scan(preferred[i]))
+      return preferred[i];
+  }
+
+  return JSON_ESCAPE_SCALAR;
+}
+
+/*
+ * Selected on first use or by json_escape_backend_set(). Threads serializing
+ * at the same time may both select it: atomics make that race harmless, every
+ * backend gives the same output. current_scan is stored last, with release,
+ * so the backend read after it is the matching one.
+ */
+static _Atomic json_escape_backend_t current_backend = JSON_ESCAPE_AUTO;
+static _Atomic(scan_fn) current_scan = NULL;
+
+int json_escape_backend_set(json_escape_backend_t backend) {
+  if (backend == JSON_ESCAPE_AUTO)
+    backend = detect_backend();
+
+  scan_fn scan = backend_scan(backend);
+  if (!scan)
+    return -1;
+
+  atomic_store_explicit(&current_backend, backend, memory_order_relaxed);
+  atomic_store_explicit(&current_scan, scan, memory_order_release);
+
+  return 0;
+}
+
+json_escape_backend_t json_escape_backend_get(void) {
+  if (!atomic_load_explicit(&current_scan, memory_order_acquire) &&
+      json_escape_backend_set(JSON_ESCAPE_DEFAULT_BACKEND))
+    json_escape_backend_set(JSON_ESCAPE_AUTO);
+
+  return atomic_load_explicit(&current_backend, memory_order_relaxed);
+}
+
+const unsigned char *json_scan_backend(const unsigned char *str,
+                                       const unsigned char *end) {
+  scan_fn scan = atomic_load_explicit(&current_scan, memory_order_relaxed);
+
+  if (!scan) {
+    json_escape_backend_get();
+    scan = atomic_load_explicit(&current_scan, memory_order_relaxed);
+  }
+
+  return scan(str, end);
+}
@@ -0,0 +1,82 @@
+#ifndef JSON_ESCAPE_H_
+#define JSON_ESCAPE_H_
+
+#include "../include/json_serializer.h"
+
+#include <stdint.h>
+
+/**
+ * @brief Internal string escaping helpers shared by the serializer.
+ */
+
+/**
+ * @brief Escape class of every byte.
+ *
+ * 0 when the byte is copied as is, otherwise the character following the
+ * '\\' of its escape sequence: 'u' for the bytes of utf-8 sequences and the
+ * control characters without a short escape, written as \uXXXX.
+ */
+extern const char json_escape_table[256];
+
+/**
+ * @brief Length of the escaped form of every ascii byte, 1 when copied as is,
+ * 2 for a short escape and 6 for \u00XX.
+ */
+extern const unsigned char json_escape_len[128];
+
+/** Utf-8 decoder states, multiples of 12 indexing json_utf8_transition. */
+#define JSON_UTF8_ACCEPT 0
+#define JSON_UTF8_REJECT 12
+
+extern const unsigned char json_utf8_class[256];
+extern const unsigned char json_utf8_transition[9 * 12];
+
+/**
+ * @brief Feed one byte to the utf-8 decoder.
+ *
+ * Starting from JSON_UTF8_ACCEPT, the state is back to JSON_UTF8_ACCEPT with
+ * the code point in codepoint once a whole valid sequence is read, and
+ * JSON_UTF8_REJECT as soon as the sequence cannot be valid.
+ *
+ * @return the new state.
+ */
+static inline unsigned int json_utf8_decode(unsigned int state,
+                                            uint32_t *codepoint,
+                                            unsigned char byte) {
+  unsigned int class = json_utf8_class[byte];
+
+  *codepoint = (state != JSON_UTF8_ACCEPT) ? (byte & 0x3Fu) | (*codepoint << 6)
+                                           : (0xFFu >> class) & byte;
+
+  return json_utf8_transition[state + class];
+}
+
+/**
+ * Shortest input handed to the escape backend. Below, the indirect call and
+ * the tail handling of the vector scanners cost more than a table lookup per
+ * byte.
+ */
+#define JSON_SCAN_MIN 16
+
+/**
+ * @brief Same as json_scan_plain(), always with the escape backend selected
+ * with json_escape_backend_set().
+ */
+const unsigned char *json_scan_backend(const unsigned char *str,
+                                       const unsigned char *end);
+
+/**
+ * @brief Return the first byte of [str, end) that needs escaping, or end.
+ */
+static inline const unsigned char *json_scan_plain(const unsigned char *str,
+                                                   const unsigned char *end) {
+  if (end - str >= JSON_SCAN_MIN)
+    return json_scan_backend(str, end);
+
+  while (str < end && !json_escape_table[*str])
+    ++str;
+
+  return str;
+}
+
+#endif /* ifndef JSON_ESCAPE_H_ */
@@ -0,0 +1,102 @@
+#ifndef JSON_NUMBER_H_
+#define JSON_NUMBER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Internal decimal formatting helpers shared by the serializer.
+ */
+
+/** Longest decimal integer, "-9223372036854775808" or "18446744073709551615". */
+#define JSON_INT_MAX_LEN 20
+
+/** "00" "01" ... "99", two digits per lookup. */
+extern const char json_digit_pairs[200];
+
+/** 0 then 10^1 up to 10^19. */
+extern const uint64_t json_powers_of_10[20];
+
+/**
+ * @brief Number of decimal digits of value.
+ */
+static inline unsigned int json_u64_len(uint64_t value) {
+#if defined(__GNUC__)
+  /* log10 approximation from the bit length, corrected by one comparison */
+  unsigned int t = ((64 - __builtin_clzll(value | 1)) * 1233) >> 12;
+  return t - (value < json_powers_of_10[t]) + 1;
+#else
+  unsigned int len = 1;
+
+  while (len < 20 && value >= json_powers_of_10[len])
+    ++len;
+
+  return len;
+#endif
+}
+
+/**
+ * @brief Write the len digits of value in [out, out + len).
+ *
+ * len must be json_u64_len(value), digits are written two at a time from the
+ * end of the number so no reverse pass is needed.
+ */
+static inline void json_u64_write(char *out, uint64_t value, unsigned int len) {
+  char *cur = out + len;
+
+  while (value >= 100) {
+    unsigned int pair = (unsigned int)(value % 100) * 2;
+    value /= 100;
+    cur -= 2;
+    memcpy(cur, json_digit_pairs + pair, 2);
+  }
+
+  if (value >= 10) {
+    memcpy(cur - 2, json_digit_pairs + value * 2, 2);
+  } else {
+    cur[-1] = (char)('0' + value);
+  }
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/**
+ * @brief The 8 digits of value < 10^8 as ascii bytes of a 64-bit word, zeros
+ * in front, the first digit in the low byte.
+ *
+ * Split in two 4-digit lanes, then 2-digit and 1-digit lanes, each split is
+ * one multiply for all the lanes at once.
+ */
+static inline uint64_t json_u32_digits8(uint32_t value) {
+  uint64_t merged = (value / 10000) | ((uint64_t)(value % 10000) << 32);
+  uint64_t top = ((merged * 10486) >> 20) & ((0x7fULL << 32) | 0x7fULL);
+  uint64_t pairs = ((merged - 100 * top) << 16) + top;
+  uint64_t tens = ((pairs * 103) >> 10) & 0x000f000f000f000fULL;
+
+  return tens + ((pairs - 10 * tens) << 8) + 0x3030303030303030ULL;
+}
+
+/**
+ * @brief Write the len digits of a 32-bit value, [out, out + 10) must be
+ * writable.
+ *
+ * len must be json_u64_len(value). Branch free up to 8 digits, the digit word
+ * is shifted so its last len bytes land in front and stored in one go.
+ */
+static inline void json_u32_write(char *out, uint32_t value, unsigned int len) {
+  uint64_t digits = json_u32_digits8(value % 100000000);
+
+  if (len > 8) {
+    memcpy(out, json_digit_pairs + (value / 100000000) * 2 + 10 - len, 2);
+    memcpy(out + len - 8, &digits, 8);
+  } else {
+    digits >>= 8 * (8 - len);
+    memcpy(out, &digits, 8);
+  }
+}
+#else
+static inline void json_u32_write(char *out, uint32_t value, unsigned int len) {
+  json_u64_write(out, value, len);
+}
+#endif
+
+#endif /* ifndef JSON_NUMBER_H_ */
@@ -1,333 +1,436 @@
 #include "../include/json_serializer.h"
+#include "../include/json_writer.h"
+#include "json_escape.h"
+#include "json_number.h"
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The buf/remaining_size functions are thin wrappers over the writer: a
+ * writer is set up on [buf, buf + *remaining_size), makes the call, and the
+ * new cursor and remaining size are handed back. Structural tokens, literals
+ * and integers are short enough to be written straight into buf instead.
+ */
 
-char *append(char *buf, const char *suffix, size_t *remaining_size) {
-  if (!buf)
+/**
+ * @brief Set a writer up on buf, for one wrapper call.
+ *
+ * Lighter than json_writer_init() and json_writer_set_options(): with
+ * JSON_WRITER_TRAILING_COMMA on a plain buffer, nesting is not tracked and
+ * the stream, growable and iovec fields are only tested for NULL, so the
+ * rest of the writer is left unset.
+ */
+static inline int attach(json_writer_t *w, char *buf,
+                         size_t *remaining_size) {
+  if (!buf || *remaining_size == 0)
+    return 0;
+
+  w->start = buf;
+  w->cursor = buf;
+  /* same as json_writer_init(), the last byte is kept for the null byte */
+  w->end = buf + *remaining_size - 1;
+  w->error = JSON_OK;
+  w->depth = 0;
+  w->state = 0;
+  w->options = JSON_WRITER_TRAILING_COMMA;
+  w->flush = NULL;
+  w->flushed = 0;
+  w->resize = NULL;
+  w->measure = 0;
+  w->iov = NULL;
+
+#ifdef JSON_WRITER_STATS
+  memset(&w->stats, 0, sizeof(w->stats));
+#endif
+
+  return 1;
+}
+
+static inline char *detach(json_writer_t *w, size_t *remaining_size) {
+  if (w->error != JSON_OK)
     return NULL;
 
-  for (; *suffix; ++suffix) {
-    /* no more space */
-    if (*remaining_size == 0)
-      return NULL;
+  *remaining_size = w->end - w->cursor + 1;
+  return w->cursor;
+}
 
-    *buf = *suffix;
+/**
+ * @brief Run a writer call on buf and remaining_size, return the new buf.
+ */
+#define WRAP(buf, remaining_size, call)                                        \
+  do {                                                                         \
+    json_writer_t w;                                                           \
+    if (!attach(&w, (buf), (remaining_size)))                                  \
+      return NULL;                                                             \
+    call;                                                                      \
+    return detach(&w, (remaining_size));                                       \
+  } while (0)
 
-    ++buf;
-    --(*remaining_size);
+/**
+ * @brief Remove the ',' written before buf if any.
+ *
+ * The previous token is outside of the writer, buf[-1] is part of the caller
+ * buffer: a close is never the first write into it, see json_serializer.h.
+ */
+static inline char *remove_comma(char *buf, size_t *remaining_size) {
+  if (buf && buf[-1] == ',') {
+    ++(*remaining_size);
+    --buf;
   }
 
-  if (*remaining_size == 0)
-    return NULL;
-
-  /* end with a null byte */
-  *buf = '\0';
-
   return buf;
 }
 
 /**
- * @brief Append while removing last character if required (,)
+ * @brief Copy len bytes of src at buf, in one capacity check.
+ *
+ * Same output and errors as the writer with JSON_WRITER_TRAILING_COMMA, the
+ * last byte of the buffer is kept for the null byte.
  */
-char *append_close(char *buf, const char *suffix, size_t *remaining_size) {
+static inline char *append_n(char *buf, const char *src, size_t len,
+                             size_t *remaining_size) {
   if (!buf)
     return NULL;
 
-  if (buf[-1] == ',') {
-    ++(*remaining_size);
-    --buf;
-  }
-  return append(buf, suffix, remaining_size);
+  /* no more space (keep one byte for the null byte) */
+  if (len >= *remaining_size)
+    return NULL;
+
+  memcpy(buf, src, len);
+  *remaining_size -= len;
+
+  return buf + len;
 }
 
+#define append_lit(buf, lit, remaining_size)                                   \
+  append_n((buf), "" lit, sizeof(lit) - 1, (remaining_size))
+
 /**
- * @brief Append element and add ',' after.
+ * @brief Whether name has nothing to escape, its length in *len if so.
+ *
+ * The null byte has an escape class, the scan stops on it.
  */
-char *append_element(char *buf, const char *value, size_t *remaining_size) {
-  if (!buf)
+static inline int plain_key(const char *name, size_t *len) {
+  const unsigned char *cur = (const unsigned char *)name;
+
+  while (!json_escape_table[*cur])
+    ++cur;
+
+  *len = (const char *)cur - name;
+  return *cur == '\0';
+}
+
+/**
+ * @brief Write "name": and len bytes of token, in one capacity check.
+ *
+ * name is plain, see plain_key().
+ */
+static inline char *key_token(char *buf, const char *name, size_t name_len,
+                              const char *token, size_t len,
+                              size_t *remaining_size) {
+  size_t total = name_len + 3 + len;
+
+  /* no more space (keep one byte for the null byte) */
+  if (total >= *remaining_size)
     return NULL;
 
-  buf = append(buf, value, remaining_size);
-  buf = append(buf, ",", remaining_size);
+  buf[0] = '"';
+  memcpy(buf + 1, name, name_len);
+  buf[name_len + 1] = '"';
+  buf[name_len + 2] = ':';
+  memcpy(buf + name_len + 3, token, len);
+  *remaining_size -= total;
 
-  return buf;
+  return buf + total;
 }
 
-char *conv(char *buf, long num, int base, size_t *remaining_size) {
+/**
+ * @brief Write an integer and add ',' after, in one capacity check.
+ */
+static inline char *integer(char *buf, uint64_t magnitude, int negative,
+                            size_t *remaining_size) {
   if (!buf)
     return NULL;
 
-  if (num == 0) {
-    if (base <= 10)
-      return append(buf, "0", remaining_size);
-    return append(buf, "00", remaining_size);
-  }
+  unsigned int digits = json_u64_len(magnitude);
+  size_t len = (size_t)negative + digits + 1;
 
-  /* conv */
+  /* no more space (keep one byte for the null byte) */
+  if (len >= *remaining_size)
+    return NULL;
 
-  if (num < 0) {
-    buf = append(buf, "-", remaining_size);
-    num = -num;
-  }
+  *buf = '-';
+  json_u64_write(buf + negative, magnitude, digits);
+  buf[len - 1] = ',';
+  *remaining_size -= len;
 
-  char *start = buf;
+  return buf + len;
+}
 
-  while (num) {
-    if (*remaining_size == 0)
-      return NULL;
+static inline char *int64(char *buf, int64_t number, size_t *remaining_size) {
+  /* 0 - (uint64_t)number does not overflow for INT64_MIN */
+  if (number < 0)
+    return integer(buf, 0 - (uint64_t)number, 1, remaining_size);
+  return integer(buf, (uint64_t)number, 0, remaining_size);
+}
 
-    int part = (num % base);
-    char digit = 0;
+char *json_obj_open(char *buf, const char *name, size_t *remaining_size) {
+  size_t len;
 
-    if (part < 10) {
-      digit = '0' + part;
-    } else {
-      digit = 'A' + (part - 10);
-    }
+  if (!name)
+    return append_lit(buf, "{", remaining_size);
+  if (buf && plain_key(name, &len))
+    return key_token(buf, name, len, "{", 1, remaining_size);
 
-    *buf = digit;
-    ++buf;
-    --(*remaining_size);
+  WRAP(buf, remaining_size, json_writer_obj_open(&w, name));
+}
 
-    num /= base;
-  }
+char *json_obj_close(char *buf, size_t *remaining_size) {
+  buf = remove_comma(buf, remaining_size);
+  return append_lit(buf, "},", remaining_size);
+}
 
-  char *end = buf - 1;
+char *json_arr_open(char *buf, const char *name, size_t *remaining_size) {
+  size_t len;
 
-  /* reverse */
+  if (!name)
+    return append_lit(buf, "[", remaining_size);
+  if (buf && plain_key(name, &len))
+    return key_token(buf, name, len, "[", 1, remaining_size);
 
-  while (start < end) {
-    char tmp = *start;
-    *start = *end;
-    *end = tmp;
+  WRAP(buf, remaining_size, json_writer_arr_open(&w, name));
+}
 
-    ++start;
-    --end;
-  }
+char *json_arr_close(char *buf, size_t *remaining_size) {
+  buf = remove_comma(buf, remaining_size);
+  return append_lit(buf, "],", remaining_size);
+}
 
-  return buf;
+char *json_true(char *buf, size_t *remaining_size) {
+  return append_lit(buf, "true,", remaining_size);
 }
 
-char *ltoa(char *buf, long num, size_t *remaining_size) {
-  return conv(buf, num, 10, remaining_size);
+char *json_false(char *buf, size_t *remaining_size) {
+  return append_lit(buf, "false,", remaining_size);
 }
 
-char *hex(char *buf, long num, size_t *remaining_size) {
-  return conv(buf, num, 16, remaining_size);
+char *json_bool(char *buf, int boolean, size_t *remaining_size) {
+  if (boolean)
+    return json_true(buf, remaining_size);
+  return json_false(buf, remaining_size);
 }
 
-char const unicode_length[] = {1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 2, 2, 3, 4};
+char *json_null(char *buf, size_t *remaining_size) {
+  return append_lit(buf, "null,", remaining_size);
+}
 
-char *escape_unicode(char *buf, const char **str, size_t *remaining_size) {
-  if ((**str & 0xC0) != 0xC0)
-    return NULL;
+char *json_str(char *buf, const char *str, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_str(&w, str));
+}
 
-  buf = append(buf, "\\u", remaining_size);
+char *json_strn(char *buf, const char *str, size_t len,
+                size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_strn(&w, str, len));
+}
 
-  int unicode_idx = ((unsigned char)(**str) & 0xFF) >> 4;
-  int unicode_len = unicode_length[unicode_idx];
+char *json_arr_int32(char *buf, const char *name, const int32_t *values,
+                     size_t count, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_arr_int32(&w, name, values, count));
+}
 
-  unsigned int unicode = 0;
-  const char *ustr = *str;
+char *json_arr_double(char *buf, const char *name, const double *values,
+                      size_t count, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_arr_double(&w, name, values, count));
+}
 
-  for (int i = 0; i < unicode_len; ++i) {
-    if (*ustr == '\0')
-      return NULL;
+char *json_arr_bool(char *buf, const char *name, const int *values,
+                    size_t count, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_arr_bool(&w, name, values, count));
+}
 
-    unicode = (unicode << 8) | (unsigned char)(*ustr);
+char *json_base64(char *buf, const void *data, size_t len,
+                  size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_base64(&w, data, len));
+}
 
-    ++ustr;
-  }
+char *json_hex(char *buf, const void *data, size_t len,
+               size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_hex(&w, data, len));
+}
 
-  *str = *str + unicode_len - 1;
-
-  unsigned int mask = (unicode <= 0x00EFBFBF) ? 0x000F0000 : 0x003F0000;
-  unsigned int codepoint =
-      ((unicode & 0x07000000) >> 6) | ((unicode & mask) >> 4) |
-      ((unicode & 0x00003F00) >> 2) | (unicode & 0x0000003F);
-
-  switch (unicode_len) {
-  case 1:
-    buf = hex(buf, 0, remaining_size);
-    buf = hex(buf, codepoint & 0xFF, remaining_size);
-    return buf;
-  case 2:
-    buf = hex(buf, (codepoint >> 8) & 0xFF, remaining_size);
-    buf = hex(buf, codepoint & 0xFF, remaining_size);
-    return buf;
-  case 3:
-    /* not really sure if this is possible to have a second part here */
-    if ((codepoint >> 16) & 0xFF) {
-      buf = hex(buf, 0, remaining_size);
-      buf = hex(buf, (codepoint >> 16) & 0xFF, remaining_size);
-      buf = append(buf, "\\u", remaining_size);
-    }
-    buf = hex(buf, (codepoint >> 8) & 0xFF, remaining_size);
-    buf = hex(buf, codepoint & 0xFF, remaining_size);
-    return buf;
-  case 4:;
-    /* convert utf-32 into two utf-16 code */
-    unsigned int high = 0;
-    unsigned int low = 0;
-
-    if (codepoint < 0x10000) {
-      low = codepoint;
-    } else {
-      unsigned int tmp = codepoint - 0x10000;
-      high = (((tmp << 12) >> 22) + 0xD800);
-      low = (((tmp << 22) >> 22) + 0xDC00);
-    }
-
-    buf = hex(buf, high >> 8 & 0xFF, remaining_size);
-    buf = hex(buf, high & 0xFF, remaining_size);
-    buf = append(buf, "\\u", remaining_size);
-    buf = hex(buf, low >> 8 & 0xFF, remaining_size);
-    buf = hex(buf, low & 0xFF, remaining_size);
-    return buf;
-  default:
-    return NULL;
-  }
+char *json_raw(char *buf, const char *json, size_t len,
+               size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_raw(&w, json, len));
 }
 
-char *escape_str(char *buf, const char *str, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_number(char *buf, long number, size_t *remaining_size) {
+  return int64(buf, number, remaining_size);
+}
 
-  for (; *str; ++str) {
-    if (!buf || *remaining_size == 0)
-      return NULL;
-
-    switch (*str) {
-    case '\"':
-      buf = append(buf, "\\\"", remaining_size);
-      break;
-    case '\\':
-      buf = append(buf, "\\\\", remaining_size);
-      break;
-    case '/':
-      buf = append(buf, "\\/", remaining_size);
-      break;
-    case '\b':
-      buf = append(buf, "\\b", remaining_size);
-      break;
-    case '\f':
-      buf = append(buf, "\\f", remaining_size);
-      break;
-    case '\n':
-      buf = append(buf, "\\n", remaining_size);
-      break;
-    case '\r':
-      buf = append(buf, "\\r", remaining_size);
-      break;
-    case '\t':
-      buf = append(buf, "\\t", remaining_size);
-      break;
-    default:
-      // check for unicode character
-      if ((*str & 0xC0) == 0xC0) {
-        buf = escape_unicode(buf, &str, remaining_size);
-        break;
-      }
-
-      *buf = *str;
-      ++buf;
-      --(*remaining_size);
-    }
-  }
+char *json_int64(char *buf, int64_t number, size_t *remaining_size) {
+  return int64(buf, number, remaining_size);
+}
 
-  return buf;
+char *json_uint64(char *buf, uint64_t number, size_t *remaining_size) {
+  return integer(buf, number, 0, remaining_size);
 }
 
-char *string(char *buf, const char *key, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_int32(char *buf, int32_t number, size_t *remaining_size) {
+  return int64(buf, number, remaining_size);
+}
 
-  buf = append(buf, "\"", remaining_size);
-  buf = escape_str(buf, key, remaining_size);
-  buf = append(buf, "\"", remaining_size);
+char *json_double(char *buf, double number, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_double(&w, number));
+}
 
-  return buf;
+char *json_float(char *buf, float number, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_float(&w, number));
 }
 
-char *key(char *buf, const char *key, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_double_fixed(char *buf, double number, unsigned int precision,
+                        size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_double_fixed(&w, number, precision));
+}
 
-  buf = string(buf, key, remaining_size);
-  buf = append(buf, ":", remaining_size);
+char *json_key(char *buf, const char *name, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_key(&w, name));
+}
 
-  return buf;
+char *json_key_trusted(char *buf, const char *name, size_t len,
+                       size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_key_trusted(&w, name, len));
 }
 
-char *json_obj_open(char *buf, const char *name, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_kv_str(char *buf, const char *name, const char *str,
+                  size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_str(&w, name, str));
+}
+
+char *json_kv_strn(char *buf, const char *name, const char *str, size_t len,
+                   size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_strn(&w, name, str, len));
+}
 
-  if (name)
-    buf = key(buf, name, remaining_size);
+char *json_kv_number(char *buf, const char *name, long number,
+                     size_t *remaining_size) {
+  size_t len;
 
-  return append(buf, "{", remaining_size);
+  if (buf && plain_key(name, &len)) {
+    buf = key_token(buf, name, len, "", 0, remaining_size);
+    return int64(buf, number, remaining_size);
+  }
+
+  WRAP(buf, remaining_size, json_writer_kv_int64(&w, name, number));
 }
 
-char *json_obj_close(char *buf, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_kv_int64(char *buf, const char *name, int64_t number,
+                    size_t *remaining_size) {
+  size_t len;
+
+  if (buf && plain_key(name, &len)) {
+    buf = key_token(buf, name, len, "", 0, remaining_size);
+    return int64(buf, number, remaining_size);
+  }
 
-  return append_close(buf, "},", remaining_size);
+  WRAP(buf, remaining_size, json_writer_kv_int64(&w, name, number));
 }
 
-char *json_arr_open(char *buf, const char *name, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_kv_uint64(char *buf, const char *name, uint64_t number,
+                     size_t *remaining_size) {
+  size_t len;
 
-  if (name)
-    buf = key(buf, name, remaining_size);
+  if (buf && plain_key(name, &len)) {
+    buf = key_token(buf, name, len, "", 0, remaining_size);
+    return integer(buf, number, 0, remaining_size);
+  }
 
-  return append(buf, "[", remaining_size);
+  WRAP(buf, remaining_size, json_writer_kv_uint64(&w, name, number));
 }
 
-char *json_arr_close(char *buf, size_t *remaining_size) {
-  return append_close(buf, "],", remaining_size);
+char *json_kv_int32(char *buf, const char *name, int32_t number,
+                    size_t *remaining_size) {
+  size_t len;
+
+  if (buf && plain_key(name, &len)) {
+    buf = key_token(buf, name, len, "", 0, remaining_size);
+    return int64(buf, number, remaining_size);
+  }
+
+  WRAP(buf, remaining_size, json_writer_kv_int64(&w, name, number));
 }
 
-char *json_true(char *buf, size_t *remaining_size) {
-  return append_element(buf, "true", remaining_size);
+char *json_kv_double(char *buf, const char *name, double number,
+                     size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_double(&w, name, number));
 }
 
-char *json_false(char *buf, size_t *remaining_size) {
-  return append_element(buf, "false", remaining_size);
+char *json_kv_float(char *buf, const char *name, float number,
+                    size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_float(&w, name, number));
 }
 
-char *json_bool(char *buf, int boolean, size_t *remaining_size) {
-  if (boolean) {
-    return json_true(buf, remaining_size);
+char *json_kv_double_fixed(char *buf, const char *name, double number,
+                           unsigned int precision, size_t *remaining_size) {
+  WRAP(buf, remaining_size,
+       json_writer_kv_double_fixed(&w, name, number, precision));
+}
+
+char *json_kv_bool(char *buf, const char *name, int boolean,
+                   size_t *remaining_size) {
+  size_t len;
+
+  if (buf && plain_key(name, &len)) {
+    if (boolean)
+      return key_token(buf, name, len, "true,", 5, remaining_size);
+    return key_token(buf, name, len, "false,", 6, remaining_size);
   }
 
-  return json_false(buf, remaining_size);
+  WRAP(buf, remaining_size, json_writer_kv_bool(&w, name, boolean));
 }
 
-char *json_null(char *buf, size_t *remaining_size) {
-  return append_element(buf, "null", remaining_size);
+char *json_kv_null(char *buf, const char *name, size_t *remaining_size) {
+  size_t len;
+
+  if (buf && plain_key(name, &len))
+    return key_token(buf, name, len, "null,", 5, remaining_size);
+
+  WRAP(buf, remaining_size, json_writer_kv_null(&w, name));
 }
 
-char *json_str(char *buf, const char *str, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_kv_base64(char *buf, const char *name, const void *data,
+                     size_t len, size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_base64(&w, name, data, len));
+}
 
-  buf = string(buf, str, remaining_size);
-  buf = append(buf, ",", remaining_size);
+char *json_kv_hex(char *buf, const char *name, const void *data, size_t len,
+                  size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_hex(&w, name, data, len));
+}
 
-  return buf;
+char *json_kv_raw(char *buf, const char *name, const char *json, size_t len,
+                  size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_kv_raw(&w, name, json, len));
 }
 
-char *json_number(char *buf, long number, size_t *remaining_size) {
-  if (!buf)
-    return NULL;
+char *json_template_open(char *buf, const json_template_t *tpl,
+                         size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_template_open(&w, tpl));
+}
 
-  buf = ltoa(buf, number, remaining_size);
-  return append(buf, ",", remaining_size);
+char *json_template_key(char *buf, const json_template_t *tpl, size_t field,
+                        size_t *remaining_size) {
+  WRAP(buf, remaining_size, json_writer_template_key(&w, tpl, field));
 }
 
 char *json_end(char *buf, size_t *remaining_size) {
-  return append_close(buf, "", remaining_size);
+  buf = remove_comma(buf, remaining_size);
+
+  /* the only null byte of the document, space is always kept for it */
+  if (!buf || *remaining_size == 0)
+    return NULL;
+
+  *buf = '\0';
+  return buf;
 }
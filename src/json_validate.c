@@ -0,0 +1,186 @@
+#include "json_validate.h"
+#include "../include/json_writer.h"
+
+#include <stddef.h>
+
+typedef struct {
+  const char *cur;
+  const char *end;
+} cursor_t;
+
+static int value(cursor_t *c, unsigned int depth);
+
+static int is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static void skip_space(cursor_t *c) {
+  while (c->cur < c->end && (*c->cur == ' ' || *c->cur == '\t' ||
+                             *c->cur == '\n' || *c->cur == '\r'))
+    ++c->cur;
+}
+
+static int peek(const cursor_t *c) {
+  return c->cur < c->end ? (unsigned char)*c->cur : -1;
+}
+
+static int literal(cursor_t *c, const char *lit, size_t len) {
+  if ((size_t)(c->end - c->cur) < len)
+    return -1;
+
+  for (size_t i = 0; i < len; ++i)
+    if (c->cur[i] != lit[i])
+      return -1;
+
+  c->cur += len;
+  return 0;
+}
+
+static int digits(cursor_t *c) {
+  if (!is_digit(peek(c)))
+    return -1;
+
+  while (is_digit(peek(c)))
+    ++c->cur;
+
+  return 0;
+}
+
+static int number(cursor_t *c) {
+  if (peek(c) == '-')
+    ++c->cur;
+
+  /* no leading zero */
+  if (peek(c) == '0')
+    ++c->cur;
+  else if (digits(c) != 0)
+    return -1;
+
+  if (peek(c) == '.') {
+    ++c->cur;
+    if (digits(c) != 0)
+      return -1;
+  }
+
+  if (peek(c) == 'e' || peek(c) == 'E') {
+    ++c->cur;
+    if (peek(c) == '+' || peek(c) == '-')
+      ++c->cur;
+    if (digits(c) != 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+static int is_hex(int c) {
+  return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int string(cursor_t *c) {
+  /* opening quote checked by the caller */
+  ++c->cur;
+
+  for (;;) {
+    int ch = peek(c);
+
+    if (ch < 0x20)
+      return -1;
+
+    ++c->cur;
+
+    if (ch == '"')
+      return 0;
+
+    if (ch != '\\')
+      continue;
+
+    switch (peek(c)) {
+    case '"':
+    case '\\':
+    case '/':
+    case 'b':
+    case 'f':
+    case 'n':
+    case 'r':
+    case 't':
+      ++c->cur;
+      break;
+    case 'u':
+      ++c->cur;
+      for (int i = 0; i < 4; ++i, ++c->cur)
+        if (!is_hex(peek(c)))
+          return -1;
+      break;
+    default:
+      return -1;
+    }
+  }
+}
+
+/**
+ * @brief Elements of an object or an array, after the opening bracket.
+ */
+static int members(cursor_t *c, char close, unsigned int depth) {
+  skip_space(c);
+  if (peek(c) == close) {
+    ++c->cur;
+    return 0;
+  }
+
+  for (;;) {
+    if (close == '}') {
+      skip_space(c);
+      if (peek(c) != '"' || string(c) != 0)
+        return -1;
+
+      skip_space(c);
+      if (peek(c) != ':')
+        return -1;
+      ++c->cur;
+    }
+
+    if (value(c, depth) != 0)
+      return -1;
+
+    skip_space(c);
+    if (peek(c) == close) {
+      ++c->cur;
+      return 0;
+    }
+
+    if (peek(c) != ',')
+      return -1;
+    ++c->cur;
+  }
+}
+
+static int value(cursor_t *c, unsigned int depth) {
+  skip_space(c);
+
+  switch (peek(c)) {
+  case '{':
+  case '[':
+    if (depth == JSON_WRITER_MAX_DEPTH)
+      return -1;
+    return members(c, *c->cur++ == '{' ? '}' : ']', depth + 1);
+  case '"':
+    return string(c);
+  case 't':
+    return literal(c, "true", 4);
+  case 'f':
+    return literal(c, "false", 5);
+  case 'n':
+    return literal(c, "null", 4);
+  default:
+    return number(c);
+  }
+}
+
+int json_validate(const char *json, size_t len) {
+  cursor_t c = {json, json + len};
+
+  if (value(&c, 0) != 0)
+    return -1;
+
+  skip_space(&c);
+  return c.cur == c.end ? 0 : -1;
+}
@@ -0,0 +1,20 @@
+#ifndef JSON_VALIDATE_H_
+#define JSON_VALIDATE_H_
+
+#include <stddef.h>
+
+/**
+ * @brief Internal checker for the fragments spliced by json_writer_raw().
+ */
+
+/**
+ * @brief Check that json holds exactly one JSON value.
+ *
+ * Whitespace is allowed around the value, nesting is limited to
+ * JSON_WRITER_MAX_DEPTH levels and utf-8 is not checked.
+ *
+ * @return 0 if valid, -1 otherwise.
+ */
+int json_validate(const char *json, size_t len);
+
+#endif /* ifndef JSON_VALIDATE_H_ */
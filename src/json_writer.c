@@ -0,0 +1,1464 @@
+#include "../include/json_writer.h"
+#include "json_binary.h"
+#include "json_dtoa.h"
+#include "json_escape.h"
+#include "json_number.h"
+#include "json_validate.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if JSON_MAX_LEN_DOUBLE < JSON_DOUBLE_MAX_LEN ||                               \
+    JSON_MAX_LEN_DOUBLE_FIXED < JSON_DOUBLE_FIXED_MAX_LEN ||                   \
+    JSON_MAX_LEN_INT64 < JSON_INT_MAX_LEN
+#error "public worst case lengths below the formatters output"
+#endif
+
+#ifdef JSON_WRITER_STATS
+#define STAT_ADD(w, counter, n) ((w)->stats.counter += (n))
+#else
+#define STAT_ADD(w, counter, n) ((void)0)
+#endif
+
+/** Count one token of a json_token_t type. */
+#define STAT_TOKEN(w, type) STAT_ADD(w, tokens[type], 1)
+
+/**
+ * @brief Keep the first error and stop writing.
+ *
+ * The writer end is moved to the cursor so every following write fails its
+ * capacity check, no call has to test the error on entry.
+ */
+static void fail(json_writer_t *w, json_error_t error) {
+#ifdef JSON_WRITER_STATS
+  if (w->error == JSON_OK && error == JSON_ERR_NO_SPACE)
+    w->stats.overflow_offset = json_writer_length(w);
+#endif
+
+  if (w->error == JSON_OK)
+    w->error = error;
+
+  w->end = w->cursor;
+}
+
+/**
+ * @brief Hand the bytes written so far to the flush callback, restart at the
+ * beginning of the chunk.
+ *
+ * @return 1 if the chunk is empty again, 0 on error.
+ */
+static int drain(json_writer_t *w) {
+  size_t len = w->cursor - w->start;
+
+  if (len && w->flush(w->flush_ctx, w->start, len) != 0) {
+    fail(w, JSON_ERR_FLUSH);
+    return 0;
+  }
+
+  w->flushed += len;
+  w->cursor = w->start;
+  return 1;
+}
+
+/**
+ * @brief Reallocate the buffer of a growable writer to fit len more bytes.
+ *
+ * The capacity doubles until it fits, so a document of n bytes costs
+ * O(log n) reallocations and O(n) copies.
+ *
+ * @return 1 if the buffer grew, 0 on error.
+ */
+static int grow(json_writer_t *w, size_t len) {
+  size_t used = w->cursor - w->start;
+  size_t needed = used + len + 1;
+
+  if (needed < len) {
+    fail(w, JSON_ERR_ALLOC);
+    return 0;
+  }
+
+  size_t size = w->capacity;
+
+  while (size < needed)
+    size = (size > SIZE_MAX / 2) ? needed : size * 2;
+
+  char *buf = w->resize(w->resize_ctx, w->start, w->capacity, size);
+
+  if (!buf) {
+    fail(w, JSON_ERR_ALLOC);
+    return 0;
+  }
+
+  w->start = buf;
+  w->cursor = buf + used;
+  w->end = buf + size - 1;
+  w->capacity = size;
+  return 1;
+}
+
+/**
+ * @brief Out of line part of reserve(), the token does not fit in what is left.
+ */
+static int reserve_slow(json_writer_t *w, size_t len) {
+  if (w->error == JSON_OK) {
+    if (w->flush && drain(w) && len <= (size_t)(w->end - w->cursor))
+      return 1;
+
+    if (w->resize && grow(w, len))
+      return 1;
+  }
+
+  fail(w, JSON_ERR_NO_SPACE);
+  return 0;
+}
+
+/**
+ * @brief Make room for len contiguous bytes at the cursor.
+ *
+ * Only used for tokens shorter than JSON_WRITER_MIN_CHUNK, so a drained chunk
+ * always has room for them.
+ *
+ * A measuring writer has no room at all, every token is counted here without
+ * leaving the inline path.
+ *
+ * @return 1 if the bytes have to be written, 0 on error or when measuring.
+ */
+static inline int reserve(json_writer_t *w, size_t len) {
+  if (len <= (size_t)(w->end - w->cursor))
+    return 1;
+
+  if (w->measure) {
+    w->flushed += len;
+    return 0;
+  }
+
+  return reserve_slow(w, len);
+}
+
+/**
+ * @brief Out of line part of put(), copy src one chunk at a time.
+ */
+static void put_slow(json_writer_t *w, const char *src, size_t len) {
+  if (w->error != JSON_OK || !w->flush) {
+    if (reserve_slow(w, len)) {
+      memcpy(w->cursor, src, len);
+      w->cursor += len;
+    }
+    return;
+  }
+
+  size_t room;
+
+  while (len > (room = w->end - w->cursor)) {
+    memcpy(w->cursor, src, room);
+    w->cursor += room;
+    src += room;
+    len -= room;
+
+    if (!drain(w))
+      return;
+  }
+
+  memcpy(w->cursor, src, len);
+  w->cursor += len;
+}
+
+/**
+ * @brief Copy len bytes of src at the cursor.
+ *
+ * One capacity check and one copy per token, a measuring writer only counts
+ * len.
+ */
+static inline void put(json_writer_t *w, const char *src, size_t len) {
+  if (len > (size_t)(w->end - w->cursor)) {
+    if (w->measure)
+      w->flushed += len;
+    else
+      put_slow(w, src, len);
+    return;
+  }
+
+  memcpy(w->cursor, src, len);
+  w->cursor += len;
+}
+
+/**
+ * @brief Copy len bytes of src at the cursor, in the room made by
+ * json_writer_reserve().
+ */
+static inline void put_unchecked(json_writer_t *w, const char *src,
+                                 size_t len) {
+  memcpy(w->cursor, src, len);
+  w->cursor += len;
+}
+
+/**
+ * @brief Close the staging bytes written since the last reference into an
+ * iovec entry.
+ *
+ * @return 1 on success, 0 if the iovec array is full.
+ */
+static int end_segment(json_writer_t *w) {
+  if (w->cursor == w->segment)
+    return 1;
+
+  if (w->iov_used == w->iov_count) {
+    fail(w, JSON_ERR_NO_SPACE);
+    return 0;
+  }
+
+  w->iov[w->iov_used].iov_base = w->segment;
+  w->iov[w->iov_used].iov_len = w->cursor - w->segment;
+  ++w->iov_used;
+  w->segment = w->cursor;
+  return 1;
+}
+
+/**
+ * @brief Add an iovec entry pointing at src, nothing is copied.
+ */
+static void add_ref(json_writer_t *w, const char *src, size_t len) {
+  if (w->error != JSON_OK || !end_segment(w))
+    return;
+
+  if (w->iov_used == w->iov_count) {
+    fail(w, JSON_ERR_NO_SPACE);
+    return;
+  }
+
+  w->iov[w->iov_used].iov_base = (void *)src;
+  w->iov[w->iov_used].iov_len = len;
+  ++w->iov_used;
+  w->flushed += len;
+}
+
+/**
+ * @brief Copy len bytes of src, or reference them in place for an iovec
+ * writer when they are long enough.
+ *
+ * src has to stay valid until the iovec array is sent.
+ */
+static inline void put_ref(json_writer_t *w, const char *src, size_t len) {
+  if (w->iov && len >= JSON_WRITER_IOV_MIN_REF) {
+    add_ref(w, src, len);
+    return;
+  }
+
+  put(w, src, len);
+}
+
+/**
+ * @brief Copy a string literal, its length is known at compile time.
+ */
+#define put_lit(w, lit) put((w), "" lit, sizeof(lit) - 1)
+
+/**
+ * @brief Put while removing last character if required (,)
+ *
+ * Only used with JSON_WRITER_TRAILING_COMMA.
+ */
+static void put_close(json_writer_t *w, const char *suffix, size_t len) {
+  if (w->error == JSON_OK && w->cursor > w->start && w->cursor[-1] == ',')
+    --w->cursor;
+
+  put(w, suffix, len);
+}
+
+/** No element written yet in the current container. */
+#define STATE_FIRST 1
+/** A key was written, its value comes next. */
+#define STATE_KEY 2
+
+static inline int trailing_comma(const json_writer_t *w) {
+  return (w->options & JSON_WRITER_TRAILING_COMMA) != 0;
+}
+
+/**
+ * @brief Whether the current container is an object, from the nesting bits.
+ */
+static inline int in_object(const json_writer_t *w) {
+  return w->depth && ((w->nesting >> (w->depth - 1)) & 1);
+}
+
+/**
+ * @brief Start a value, return 1 if a ',' goes in front of it.
+ */
+static inline int value_comma(json_writer_t *w) {
+  if (trailing_comma(w))
+    return 0;
+
+  int state = w->state;
+  w->state = 0;
+
+  if (state & STATE_KEY)
+    return 0;
+
+  /* object members need a key, a document has a single root value */
+  if (in_object(w) || (!w->depth && !(state & STATE_FIRST))) {
+    fail(w, JSON_ERR_NESTING);
+    return 0;
+  }
+
+  return !(state & STATE_FIRST);
+}
+
+/**
+ * @brief Start a key, return 1 if a ',' goes in front of it.
+ */
+static inline int key_comma(json_writer_t *w) {
+  if (trailing_comma(w))
+    return 0;
+
+  int state = w->state;
+  w->state = STATE_KEY;
+
+  if (!in_object(w) || (state & STATE_KEY)) {
+    fail(w, JSON_ERR_NESTING);
+    return 0;
+  }
+
+  return !(state & STATE_FIRST);
+}
+
+/**
+ * @brief Write a token with its separators.
+ *
+ * token is the value between a ',' on each side, the ',' in front is written
+ * before the next element of a container and the one after only with
+ * JSON_WRITER_TRAILING_COMMA.
+ */
+static inline void put_value(json_writer_t *w, const char *token, size_t len) {
+  int comma = value_comma(w);
+
+  put(w, token + 1 - comma, len + comma + trailing_comma(w));
+}
+
+#define put_value_lit(w, lit) put_value((w), "," lit ",", sizeof(lit) - 1)
+
+static inline void put_value_unchecked(json_writer_t *w, const char *token,
+                                       size_t len) {
+  int comma = value_comma(w);
+
+  put_unchecked(w, token + 1 - comma, len + comma + trailing_comma(w));
+}
+
+static void push(json_writer_t *w, int object) {
+  if (trailing_comma(w))
+    return;
+
+  if (w->depth == JSON_WRITER_MAX_DEPTH) {
+    fail(w, JSON_ERR_DEPTH);
+    return;
+  }
+
+  if (object)
+    w->nesting |= (uint64_t)1 << w->depth;
+  else
+    w->nesting &= ~((uint64_t)1 << w->depth);
+
+  ++w->depth;
+  w->state = STATE_FIRST;
+
+#ifdef JSON_WRITER_STATS
+  if (w->depth > w->stats.peak_depth)
+    w->stats.peak_depth = w->depth;
+#endif
+}
+
+static void close_container(json_writer_t *w, const char *bracket,
+                            int object) {
+  if (trailing_comma(w)) {
+    put_close(w, bracket, 1);
+    put_lit(w, ",");
+    return;
+  }
+
+  /* nothing open, other kind of container, or key without value */
+  if (!w->depth || in_object(w) != object || (w->state & STATE_KEY)) {
+    fail(w, JSON_ERR_NESTING);
+    return;
+  }
+
+  --w->depth;
+  w->state = 0;
+
+  put(w, bracket, 1);
+}
+
+/**
+ * @brief Write "\\uXXXX" at out, 6 bytes, one nibble lookup per digit.
+ */
+static inline void write_u16(char *out, unsigned int unit) {
+  static const char digits[] = "0123456789ABCDEF";
+
+  out[0] = '\\';
+  out[1] = 'u';
+  out[2] = digits[(unit >> 12) & 0xF];
+  out[3] = digits[(unit >> 8) & 0xF];
+  out[4] = digits[(unit >> 4) & 0xF];
+  out[5] = digits[unit & 0xF];
+}
+
+/**
+ * @brief Decode the utf-8 sequence at str and write its \\u escape.
+ *
+ * Also used for the control characters without short escape, a single byte
+ * below 0x80 decodes to itself.
+ *
+ * Invalid and truncated sequences set JSON_ERR_UTF8. Code points above the
+ * basic multilingual plane are written as an utf-16 surrogate pair.
+ *
+ * @return the byte after the sequence.
+ */
+static const unsigned char *escape_utf8(json_writer_t *w,
+                                        const unsigned char *str,
+                                        const unsigned char *end) {
+  unsigned int state = JSON_UTF8_ACCEPT;
+  uint32_t codepoint = 0;
+
+  do {
+    if (str == end ||
+        (state = json_utf8_decode(state, &codepoint, *str++)) ==
+            JSON_UTF8_REJECT) {
+      fail(w, JSON_ERR_UTF8);
+      return end;
+    }
+  } while (state != JSON_UTF8_ACCEPT);
+
+  size_t len = (codepoint < 0x10000) ? 6 : 12;
+
+  if (!reserve(w, len))
+    return str;
+
+  if (len == 6) {
+    write_u16(w->cursor, codepoint);
+  } else {
+    codepoint -= 0x10000;
+    write_u16(w->cursor, 0xD800 | (codepoint >> 10));
+    write_u16(w->cursor + 6, 0xDC00 | (codepoint & 0x3FF));
+  }
+
+  w->cursor += len;
+  return str;
+}
+
+/**
+ * @brief Copy the run of non-ascii bytes at str as is, JSON_WRITER_UTF8_RAW.
+ *
+ * The run is validated with the same decoder as escape_utf8() unless
+ * JSON_WRITER_UTF8_UNCHECKED is set, then copied at once.
+ *
+ * @return the byte after the run.
+ */
+static const unsigned char *copy_utf8(json_writer_t *w,
+                                      const unsigned char *str,
+                                      const unsigned char *end) {
+  const unsigned char *run = str;
+
+  if (w->options & JSON_WRITER_UTF8_UNCHECKED) {
+    while (str < end && *str >= 0x80)
+      ++str;
+  } else {
+    unsigned int state = JSON_UTF8_ACCEPT;
+    uint32_t codepoint = 0;
+
+    while (str < end && (*str >= 0x80 || state != JSON_UTF8_ACCEPT)) {
+      state = json_utf8_decode(state, &codepoint, *str++);
+
+      if (state == JSON_UTF8_REJECT)
+        break;
+    }
+
+    if (state != JSON_UTF8_ACCEPT) {
+      fail(w, JSON_ERR_UTF8);
+      return end;
+    }
+  }
+
+  put_ref(w, (const char *)run, str - run);
+  return str;
+}
+
+/**
+ * @brief Whether a byte with an escape sequence is copied as is instead, from
+ * JSON_WRITER_SOLIDUS_RAW and JSON_WRITER_CONTROL_RAW.
+ */
+static inline int copied_as_is(const json_writer_t *w, unsigned char c) {
+  if (c == '/')
+    return (w->options & JSON_WRITER_SOLIDUS_RAW) != 0;
+
+  return c < 0x20 && (w->options & JSON_WRITER_CONTROL_RAW);
+}
+
+/** Longest plain run escape_short() copies, longer ones go to the scanner. */
+#define SHORT_RUN 8
+
+/**
+ * @brief Escape text dense in escapes straight into the buffer.
+ *
+ * Plain bytes and short escapes take at most 2 bytes each, the caller has
+ * room for 2 bytes per input byte up to end. Stops at the first byte needing
+ * more than a short escape, or in the first plain run longer than SHORT_RUN
+ * bytes, the rest of it is left to the scanner.
+ *
+ * @return the first byte not written.
+ */
+static const unsigned char *escape_short(json_writer_t *w,
+                                         const unsigned char *cur,
+                                         const unsigned char *end) {
+  char *out = w->cursor;
+  unsigned int plain = 0;
+
+  for (; cur < end; ++cur) {
+    unsigned char c = *cur;
+    char escape = json_escape_table[c];
+
+    if (!escape) {
+      if (++plain > SHORT_RUN)
+        break;
+
+      *out++ = (char)c;
+      continue;
+    }
+
+    if (escape == 'u' || copied_as_is(w, c))
+      break;
+
+    STAT_ADD(w, escapes, 1);
+    plain = 0;
+    out[0] = '\\';
+    out[1] = escape;
+    out += 2;
+  }
+
+  w->cursor = out;
+  return cur;
+}
+
+/**
+ * @brief Count the escaped length of [cur, end) for a measuring writer, with
+ * the default escapes.
+ *
+ * Ascii bytes add their length from json_escape_len by blocks of SHORT_RUN
+ * bytes, a block without escapes hands the rest of its plain run to the
+ * scanner, and utf-8 sequences are validated and count 6, or 12 for a
+ * surrogate pair, as escape_utf8() writes them.
+ */
+static void measure_strn(json_writer_t *w, const unsigned char *cur,
+                         const unsigned char *end) {
+  size_t len = 0;
+
+  while (cur < end) {
+    if (*cur < 0x80) {
+      const unsigned char *block = cur;
+      const unsigned char *stop =
+          (size_t)(end - cur) > SHORT_RUN ? cur + SHORT_RUN : end;
+      size_t sum = 0;
+
+      /* only a sum is carried from byte to byte, no branch on escapes */
+      for (; cur < stop && *cur < 0x80; ++cur) {
+        STAT_ADD(w, escapes, json_escape_len[*cur] != 1);
+        sum += json_escape_len[*cur];
+      }
+
+      len += sum;
+
+      /* a whole block without escapes, the rest of the run is scanned */
+      if (sum == SHORT_RUN && cur == block + SHORT_RUN) {
+        const unsigned char *run = cur;
+
+        cur = json_scan_plain(cur, end);
+        len += cur - run;
+      }
+      continue;
+    }
+
+    /* only validated, the 4-byte sequences are the ones above the bmp */
+    unsigned int state = JSON_UTF8_ACCEPT;
+    unsigned char lead = *cur;
+
+    do {
+      if (cur == end ||
+          (state = json_utf8_transition[state + json_utf8_class[*cur++]]) ==
+              JSON_UTF8_REJECT) {
+        fail(w, JSON_ERR_UTF8);
+        return;
+      }
+    } while (state != JSON_UTF8_ACCEPT);
+
+    STAT_ADD(w, escapes, 1);
+    STAT_ADD(w, unicode, 1);
+    len += (lead >= 0xF0) ? 12 : 6;
+  }
+
+  w->flushed += len;
+}
+
+/** Options copying some bytes as is, measured through the token path. */
+#define RAW_ESCAPES                                                            \
+  (JSON_WRITER_SOLIDUS_RAW | JSON_WRITER_CONTROL_RAW | JSON_WRITER_UTF8_RAW)
+
+/**
+ * @brief Escape str, len bytes.
+ *
+ * While the buffer has room for the rest of the string, text dense in
+ * escapes goes through escape_short() without a capacity check per token,
+ * except on an iovec writer where long runs have to be referenced whole.
+ * Long plain runs are found by the scanner and copied at once, or referenced
+ * by an iovec writer, and the other escapes go through put(). A measuring
+ * writer only counts, with measure_strn() unless an option copies bytes as
+ * is.
+ */
+static void escape_strn(json_writer_t *w, const char *str, size_t len) {
+  const unsigned char *cur = (const unsigned char *)str;
+  const unsigned char *end = cur + len;
+
+  if (w->measure && !(w->options & RAW_ESCAPES)) {
+    measure_strn(w, cur, end);
+    return;
+  }
+
+  while (cur < end) {
+    if (!w->iov &&
+        (size_t)(end - cur) <= (size_t)(w->end - w->cursor) / 2) {
+      cur = escape_short(w, cur, end);
+      if (cur == end)
+        break;
+    }
+
+    const unsigned char *run = cur;
+
+    /* copy the run of plain characters at once, if there is one */
+    if (!json_escape_table[*cur])
+      cur = json_scan_plain(cur, end);
+
+    if (cur != run)
+      put_ref(w, (const char *)run, cur - run);
+
+    if (cur == end)
+      break;
+
+    char escape = json_escape_table[*cur];
+
+    if (copied_as_is(w, *cur)) {
+      put(w, (const char *)cur, 1);
+      ++cur;
+    } else if (escape == 'u') {
+      /* control characters decode to themselves, written as \u00XX */
+      if ((w->options & JSON_WRITER_UTF8_RAW) && *cur >= 0x80) {
+        cur = copy_utf8(w, cur, end);
+        continue;
+      }
+
+      STAT_ADD(w, escapes, 1);
+      STAT_ADD(w, unicode, *cur >= 0x80);
+      cur = escape_utf8(w, cur, end);
+    } else {
+      STAT_ADD(w, escapes, 1);
+      char seq[2] = {'\\', escape};
+      put(w, seq, sizeof(seq));
+      ++cur;
+    }
+  }
+}
+
+static void key(json_writer_t *w, const char *key) {
+  int comma = key_comma(w);
+
+  STAT_TOKEN(w, JSON_TOKEN_KEY);
+
+  put(w, ",\"" + 1 - comma, 1 + comma);
+  escape_strn(w, key, strlen(key));
+  put_lit(w, "\":");
+}
+
+/**
+ * @brief Write an integer.
+ *
+ * The digit count is known before writing, so the whole token and its
+ * separators take one capacity check, none for the unchecked emitters.
+ */
+static inline void integer(json_writer_t *w, uint64_t magnitude, int negative,
+                           int checked) {
+  int comma = value_comma(w);
+
+  STAT_TOKEN(w, JSON_TOKEN_NUMBER);
+  unsigned int digits = json_u64_len(magnitude);
+  size_t len = comma + (size_t)negative + digits + trailing_comma(w);
+
+  if (checked && !reserve(w, len))
+    return;
+
+  char *buf = w->cursor;
+
+  buf[0] = ',';
+  buf += comma;
+  buf[0] = '-';
+  json_u64_write(buf + negative, magnitude, digits);
+  buf[negative + digits] = ',';
+  w->cursor += len;
+}
+
+static void open_container(json_writer_t *w, const char *name,
+                           const char *bracket, int object) {
+  if (name)
+    key(w, name);
+
+  int comma = value_comma(w);
+
+  STAT_TOKEN(w, object ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY);
+  put(w, bracket + 1 - comma, 1 + comma);
+  push(w, object);
+}
+
+static void reset(json_writer_t *w, char *buf, size_t size) {
+  w->start = buf;
+  w->cursor = buf;
+  w->end = buf;
+  w->error = JSON_OK;
+  w->depth = 0;
+  w->nesting = 0;
+  w->state = STATE_FIRST;
+  w->options = 0;
+  w->flush = NULL;
+  w->flush_ctx = NULL;
+  w->flushed = 0;
+  w->resize = NULL;
+  w->resize_ctx = NULL;
+  w->capacity = size;
+  w->measure = 0;
+  w->iov = NULL;
+  w->iov_count = 0;
+  w->iov_used = 0;
+  w->segment = buf;
+
+#ifdef JSON_WRITER_STATS
+  memset(&w->stats, 0, sizeof(w->stats));
+#endif
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size) {
+  reset(w, buf, size);
+
+  if (!buf || size == 0) {
+    fail(w, JSON_ERR_NO_SPACE);
+    return;
+  }
+
+  /*
+   * keep the last byte for the null byte, numbers may also write their
+   * optional ',' there without writing out of the buffer
+   */
+  w->end = buf + size - 1;
+}
+
+void json_writer_init_stream(json_writer_t *w, char *buf, size_t size,
+                             json_flush_fn flush, void *ctx) {
+  json_writer_init(w, buf, size);
+
+  if (!flush || size < JSON_WRITER_MIN_CHUNK) {
+    fail(w, JSON_ERR_INVALID);
+    return;
+  }
+
+  w->flush = flush;
+  w->flush_ctx = ctx;
+}
+
+void json_writer_init_measure(json_writer_t *w) {
+  reset(w, NULL, 0);
+  w->measure = 1;
+}
+
+void json_writer_init_iovec(json_writer_t *w, char *buf, size_t size,
+                            json_iovec_t *iov, size_t iov_count) {
+  json_writer_init(w, buf, size);
+
+  if (!iov || iov_count == 0) {
+    fail(w, JSON_ERR_INVALID);
+    return;
+  }
+
+  w->iov = iov;
+  w->iov_count = iov_count;
+}
+
+size_t json_writer_iov_count(const json_writer_t *w) { return w->iov_used; }
+
+int json_writer_stats(const json_writer_t *w, json_writer_stats_t *stats) {
+#ifdef JSON_WRITER_STATS
+  *stats = w->stats;
+  stats->bytes = json_writer_length(w);
+  return 0;
+#else
+  (void)w;
+  memset(stats, 0, sizeof(*stats));
+  return -1;
+#endif
+}
+
+static void *default_resize(void *ctx, void *ptr, size_t old_size,
+                            size_t new_size) {
+  (void)ctx;
+  (void)old_size;
+
+  if (new_size == 0) {
+    free(ptr);
+    return NULL;
+  }
+
+  return realloc(ptr, new_size);
+}
+
+void json_writer_init_growable(json_writer_t *w, size_t size,
+                               json_resize_fn resize, void *ctx) {
+  if (!resize)
+    resize = default_resize;
+
+  if (size < JSON_WRITER_MIN_CHUNK)
+    size = JSON_WRITER_MIN_CHUNK;
+
+  char *buf = resize(ctx, NULL, 0, size);
+
+  if (!buf) {
+    reset(w, NULL, 0);
+    fail(w, JSON_ERR_ALLOC);
+    return;
+  }
+
+  json_writer_init(w, buf, size);
+
+  w->resize = resize;
+  w->resize_ctx = ctx;
+  w->capacity = size;
+}
+
+char *json_writer_release(json_writer_t *w, size_t *size) {
+  if (!w->resize || w->error != JSON_OK)
+    return NULL;
+
+  char *buf = w->start;
+
+  *size = w->capacity;
+
+  /*
+   * the buffer belongs to the caller now, without a buffer nor an allocator
+   * the next token fails with JSON_ERR_NO_SPACE
+   */
+  w->start = NULL;
+  w->cursor = NULL;
+  w->end = NULL;
+  w->resize = NULL;
+
+  return buf;
+}
+
+void json_writer_dispose(json_writer_t *w) {
+  if (!w->resize || !w->start)
+    return;
+
+  w->resize(w->resize_ctx, w->start, w->capacity, 0);
+  w->start = NULL;
+  w->cursor = NULL;
+  w->end = NULL;
+  w->resize = NULL;
+}
+
+void json_writer_set_options(json_writer_t *w, unsigned int options) {
+  w->options = options;
+}
+
+json_error_t json_writer_finish(json_writer_t *w) {
+  if (trailing_comma(w))
+    put_close(w, "", 0);
+  else if (w->depth || (w->state & STATE_KEY))
+    fail(w, JSON_ERR_NESTING);
+
+  if (w->error != JSON_OK)
+    return w->error;
+
+  if (w->flush) {
+    drain(w);
+    return w->error;
+  }
+
+  if (w->measure)
+    return JSON_OK;
+
+  if (w->iov) {
+    end_segment(w);
+    return w->error;
+  }
+
+  /* released, the document already has its null byte */
+  if (!w->start)
+    return JSON_OK;
+
+  /* the only null byte of the document, space is always kept for it */
+  *w->cursor = '\0';
+
+  return JSON_OK;
+}
+
+size_t json_writer_length(const json_writer_t *w) {
+  return w->flushed + (size_t)(w->cursor - w->start);
+}
+
+void json_writer_obj_open(json_writer_t *w, const char *name) {
+  open_container(w, name, ",{", 1);
+}
+
+void json_writer_obj_close(json_writer_t *w) { close_container(w, "}", 1); }
+
+void json_writer_arr_open(json_writer_t *w, const char *name) {
+  open_container(w, name, ",[", 0);
+}
+
+void json_writer_arr_close(json_writer_t *w) { close_container(w, "]", 0); }
+
+void json_writer_true(json_writer_t *w) {
+  STAT_TOKEN(w, JSON_TOKEN_BOOL);
+  put_value_lit(w, "true");
+}
+
+void json_writer_false(json_writer_t *w) {
+  STAT_TOKEN(w, JSON_TOKEN_BOOL);
+  put_value_lit(w, "false");
+}
+
+void json_writer_bool(json_writer_t *w, int boolean) {
+  if (boolean) {
+    json_writer_true(w);
+    return;
+  }
+
+  json_writer_false(w);
+}
+
+void json_writer_null(json_writer_t *w) {
+  STAT_TOKEN(w, JSON_TOKEN_NULL);
+  put_value_lit(w, "null");
+}
+
+void json_writer_str(json_writer_t *w, const char *str) {
+  json_writer_strn(w, str, strlen(str));
+}
+
+void json_writer_strn(json_writer_t *w, const char *str, size_t len) {
+  int comma = value_comma(w);
+
+  STAT_TOKEN(w, JSON_TOKEN_STRING);
+  put(w, ",\"" + 1 - comma, 1 + comma);
+  escape_strn(w, str, len);
+  put(w, "\",", 1 + trailing_comma(w));
+}
+
+void json_writer_number(json_writer_t *w, long number) {
+  json_writer_int64(w, number);
+}
+
+void json_writer_int64(json_writer_t *w, int64_t number) {
+  /* 0 - (uint64_t)number does not overflow for INT64_MIN */
+  if (number < 0) {
+    integer(w, 0 - (uint64_t)number, 1, 1);
+    return;
+  }
+
+  integer(w, (uint64_t)number, 0, 1);
+}
+
+void json_writer_uint64(json_writer_t *w, uint64_t number) {
+  integer(w, number, 0, 1);
+}
+
+void json_writer_int32(json_writer_t *w, int32_t number) {
+  json_writer_int64(w, number);
+}
+
+void json_writer_double(json_writer_t *w, double number) {
+  char tmp[1 + JSON_DOUBLE_MAX_LEN + 1];
+  size_t len = json_dtoa(tmp + 1, number);
+
+  STAT_TOKEN(w, JSON_TOKEN_NUMBER);
+  tmp[0] = ',';
+  tmp[len + 1] = ',';
+  put_value(w, tmp, len);
+}
+
+void json_writer_float(json_writer_t *w, float number) {
+  char tmp[1 + JSON_DOUBLE_MAX_LEN + 1];
+  size_t len = json_ftoa(tmp + 1, number);
+
+  STAT_TOKEN(w, JSON_TOKEN_NUMBER);
+  tmp[0] = ',';
+  tmp[len + 1] = ',';
+  put_value(w, tmp, len);
+}
+
+void json_writer_double_fixed(json_writer_t *w, double number,
+                              unsigned int precision) {
+  char tmp[1 + JSON_DOUBLE_FIXED_MAX_LEN + 1];
+  size_t len = json_dtoa_fixed(tmp + 1, number, precision);
+
+  STAT_TOKEN(w, JSON_TOKEN_NUMBER);
+  tmp[0] = ',';
+  tmp[len + 1] = ',';
+  put_value(w, tmp, len);
+}
+
+/**
+ * @brief Write the elements of a typed array, open and close included.
+ *
+ * The first element goes through the single value call, which writes its
+ * separator. The others are formatted straight into the buffer by batches:
+ * one capacity check for as many elements of at most slot bytes, ',' included,
+ * as the room left allows. When not even one element fits, the single value
+ * call takes over, so stream, growable and measuring writers still work.
+ */
+#define WRITE_ARRAY(w, name, values, count, slot, single, format, token)       \
+  do {                                                                         \
+    json_writer_arr_open((w), (name));                                         \
+                                                                               \
+    size_t i = 0;                                                              \
+    int before = !trailing_comma(w);                                           \
+                                                                               \
+    if (count)                                                                 \
+      single((w), (values)[i++]);                                              \
+                                                                               \
+    while (i < (count) && (w)->error == JSON_OK) {                             \
+      size_t batch = (size_t)((w)->end - (w)->cursor) / (slot);                \
+                                                                               \
+      if (batch == 0) {                                                        \
+        single((w), (values)[i++]);                                            \
+        continue;                                                              \
+      }                                                                        \
+                                                                               \
+      if (batch > (count)-i)                                                   \
+        batch = (count)-i;                                                     \
+                                                                               \
+      char *buf = (w)->cursor;                                                 \
+                                                                               \
+      STAT_ADD((w), tokens[token], batch);                                     \
+      for (size_t end = i + batch; i < end; ++i) {                             \
+        buf[0] = ',';                                                          \
+        buf += before;                                                         \
+        buf += format(buf, (values)[i]);                                       \
+        buf[0] = ',';                                                          \
+        buf += !before;                                                        \
+      }                                                                        \
+                                                                               \
+      (w)->cursor = buf;                                                       \
+    }                                                                          \
+                                                                               \
+    json_writer_arr_close(w);                                                  \
+  } while (0)
+
+/** ',' and "-2147483648". */
+#define INT32_SLOT (1 + JSON_MAX_LEN_INT32)
+/** ',' and "false". */
+#define BOOL_SLOT (1 + JSON_MAX_LEN_BOOL)
+/** ',' and the longest double. */
+#define DOUBLE_SLOT (1 + JSON_MAX_LEN_DOUBLE)
+
+/* json_u32_write() stores 10 bytes past the sign, INT32_SLOT covers them */
+static inline size_t format_int32(char *out, int32_t number) {
+  /* 0 - (uint32_t)number does not overflow for INT32_MIN */
+  uint32_t magnitude = (number < 0) ? 0 - (uint32_t)number : (uint32_t)number;
+  size_t negative = number < 0;
+  unsigned int digits = json_u64_len(magnitude);
+
+  out[0] = '-';
+  json_u32_write(out + negative, magnitude, digits);
+  return negative + digits;
+}
+
+static inline size_t format_bool(char *out, int boolean) {
+  if (boolean) {
+    memcpy(out, "true", 4);
+    return 4;
+  }
+
+  memcpy(out, "false", 5);
+  return 5;
+}
+
+void json_writer_arr_int32(json_writer_t *w, const char *name,
+                           const int32_t *values, size_t count) {
+  WRITE_ARRAY(w, name, values, count, INT32_SLOT, json_writer_int32,
+              format_int32, JSON_TOKEN_NUMBER);
+}
+
+void json_writer_arr_double(json_writer_t *w, const char *name,
+                            const double *values, size_t count) {
+  WRITE_ARRAY(w, name, values, count, DOUBLE_SLOT, json_writer_double,
+              json_dtoa, JSON_TOKEN_NUMBER);
+}
+
+void json_writer_arr_bool(json_writer_t *w, const char *name,
+                          const int *values, size_t count) {
+  WRITE_ARRAY(w, name, values, count, BOOL_SLOT, json_writer_bool,
+              format_bool, JSON_TOKEN_BOOL);
+}
+
+/** Input bytes encoded per block when the output cannot be written at once. */
+#define BINARY_BLOCK 48
+
+/**
+ * @brief Write binary data as a base64 or hex string.
+ *
+ * The string is encoded straight into the buffer when it fits, a growable
+ * writer grows first. Otherwise, on a stream, iovec or measuring writer, it
+ * is encoded block by block and every block goes through put().
+ */
+static void binary(json_writer_t *w, const unsigned char *data, size_t len,
+                   int base64) {
+  int comma = value_comma(w);
+  size_t text_len = base64 ? json_base64_len(len) : 2 * len;
+
+  STAT_TOKEN(w, JSON_TOKEN_BINARY);
+  size_t total = comma + 1 + text_len + 1 + trailing_comma(w);
+
+  if (total <= (size_t)(w->end - w->cursor) ||
+      (w->resize && w->error == JSON_OK && grow(w, total))) {
+    char *buf = w->cursor;
+
+    buf[0] = ',';
+    buf += comma;
+    buf[0] = '"';
+
+    if (base64)
+      json_base64_encode(buf + 1, data, len);
+    else
+      json_hex_encode(buf + 1, data, len);
+
+    buf[text_len + 1] = '"';
+    buf[text_len + 2] = ',';
+    w->cursor += total;
+    return;
+  }
+
+  /* measuring, the length is known without encoding */
+  if (w->measure) {
+    w->flushed += total;
+    return;
+  }
+
+  put(w, ",\"" + 1 - comma, 1 + comma);
+
+  for (size_t i = 0; i < len; i += BINARY_BLOCK) {
+    char text[2 * BINARY_BLOCK];
+    size_t n = (len - i < BINARY_BLOCK) ? len - i : BINARY_BLOCK;
+
+    if (base64) {
+      json_base64_encode(text, data + i, n);
+      put(w, text, json_base64_len(n));
+    } else {
+      json_hex_encode(text, data + i, n);
+      put(w, text, 2 * n);
+    }
+  }
+
+  put(w, "\",", 1 + trailing_comma(w));
+}
+
+void json_writer_base64(json_writer_t *w, const void *data, size_t len) {
+  binary(w, data, len, 1);
+}
+
+void json_writer_hex(json_writer_t *w, const void *data, size_t len) {
+  binary(w, data, len, 0);
+}
+
+void json_writer_key(json_writer_t *w, const char *name) { key(w, name); }
+
+/**
+ * @brief Copy a trusted key and its separators at the cursor, the room is
+ * already there.
+ */
+static inline void key_at_cursor(json_writer_t *w, const char *name,
+                                 size_t len, int comma) {
+  char *buf = w->cursor;
+
+  buf[0] = ',';
+  buf += comma;
+  buf[0] = '"';
+  memcpy(buf + 1, name, len);
+  buf[len + 1] = '"';
+  buf[len + 2] = ':';
+  w->cursor += comma + len + 3;
+}
+
+void json_writer_key_trusted(json_writer_t *w, const char *name, size_t len) {
+  int comma = key_comma(w);
+
+  STAT_TOKEN(w, JSON_TOKEN_KEY);
+
+  /* a key longer than a stream chunk or referenced in place is in pieces */
+  if ((w->flush && comma + len + 3 > (size_t)(w->end - w->cursor)) ||
+      (w->iov && len >= JSON_WRITER_IOV_MIN_REF)) {
+    put(w, ",\"" + 1 - comma, 1 + comma);
+    put_ref(w, name, len);
+    put_lit(w, "\":");
+    return;
+  }
+
+  if (!reserve(w, comma + len + 3))
+    return;
+
+  key_at_cursor(w, name, len, comma);
+}
+
+void json_writer_raw(json_writer_t *w, const char *json, size_t len) {
+  /* never valid, checked even when raw values are not validated */
+  if (len == 0) {
+    fail(w, JSON_ERR_INVALID);
+    return;
+  }
+
+#ifdef JSON_VALIDATE_RAW
+  if (json_validate(json, len) != 0) {
+    fail(w, JSON_ERR_INVALID);
+    return;
+  }
+#endif
+
+  if (value_comma(w))
+    put_lit(w, ",");
+
+  STAT_TOKEN(w, JSON_TOKEN_RAW);
+  put_ref(w, json, len);
+
+  if (trailing_comma(w))
+    put_lit(w, ",");
+}
+
+void json_writer_kv_str(json_writer_t *w, const char *name, const char *str) {
+  key(w, name);
+  json_writer_str(w, str);
+}
+
+void json_writer_kv_strn(json_writer_t *w, const char *name, const char *str,
+                         size_t len) {
+  key(w, name);
+  json_writer_strn(w, str, len);
+}
+
+void json_writer_kv_number(json_writer_t *w, const char *name, long number) {
+  key(w, name);
+  json_writer_int64(w, number);
+}
+
+void json_writer_kv_int64(json_writer_t *w, const char *name, int64_t number) {
+  key(w, name);
+  json_writer_int64(w, number);
+}
+
+void json_writer_kv_uint64(json_writer_t *w, const char *name,
+                           uint64_t number) {
+  key(w, name);
+  json_writer_uint64(w, number);
+}
+
+void json_writer_kv_int32(json_writer_t *w, const char *name, int32_t number) {
+  key(w, name);
+  json_writer_int64(w, number);
+}
+
+void json_writer_kv_double(json_writer_t *w, const char *name, double number) {
+  key(w, name);
+  json_writer_double(w, number);
+}
+
+void json_writer_kv_float(json_writer_t *w, const char *name, float number) {
+  key(w, name);
+  json_writer_float(w, number);
+}
+
+void json_writer_kv_double_fixed(json_writer_t *w, const char *name,
+                                 double number, unsigned int precision) {
+  key(w, name);
+  json_writer_double_fixed(w, number, precision);
+}
+
+void json_writer_kv_bool(json_writer_t *w, const char *name, int boolean) {
+  key(w, name);
+  json_writer_bool(w, boolean);
+}
+
+void json_writer_kv_null(json_writer_t *w, const char *name) {
+  key(w, name);
+  json_writer_null(w);
+}
+
+void json_writer_kv_base64(json_writer_t *w, const char *name,
+                           const void *data, size_t len) {
+  key(w, name);
+  json_writer_base64(w, data, len);
+}
+
+void json_writer_kv_hex(json_writer_t *w, const char *name, const void *data,
+                        size_t len) {
+  key(w, name);
+  json_writer_hex(w, data, len);
+}
+
+void json_writer_kv_raw(json_writer_t *w, const char *name, const char *json,
+                        size_t len) {
+  key(w, name);
+  json_writer_raw(w, json, len);
+}
+
+int json_writer_reserve(json_writer_t *w, size_t len) {
+  if (len <= (size_t)(w->end - w->cursor))
+    return 1;
+
+  /* the worst case may not fit where the actual tokens do, no error here */
+  if (w->error != JSON_OK || w->measure)
+    return 0;
+
+  if (w->flush)
+    return drain(w) && len <= (size_t)(w->end - w->cursor);
+
+  return w->resize && grow(w, len);
+}
+
+void json_writer_bool_unchecked(json_writer_t *w, int boolean) {
+  STAT_TOKEN(w, JSON_TOKEN_BOOL);
+
+  if (boolean) {
+    put_value_unchecked(w, ",true,", 4);
+    return;
+  }
+
+  put_value_unchecked(w, ",false,", 5);
+}
+
+void json_writer_null_unchecked(json_writer_t *w) {
+  STAT_TOKEN(w, JSON_TOKEN_NULL);
+  put_value_unchecked(w, ",null,", 4);
+}
+
+void json_writer_int64_unchecked(json_writer_t *w, int64_t number) {
+  if (number < 0) {
+    integer(w, 0 - (uint64_t)number, 1, 0);
+    return;
+  }
+
+  integer(w, (uint64_t)number, 0, 0);
+}
+
+void json_writer_uint64_unchecked(json_writer_t *w, uint64_t number) {
+  integer(w, number, 0, 0);
+}
+
+void json_writer_int32_unchecked(json_writer_t *w, int32_t number) {
+  json_writer_int64_unchecked(w, number);
+}
+
+/**
+ * @brief Format a double or a float straight at the cursor.
+ */
+static inline void real_unchecked(json_writer_t *w, double number, int single) {
+  int comma = value_comma(w);
+
+  STAT_TOKEN(w, JSON_TOKEN_NUMBER);
+  char *buf = w->cursor;
+
+  buf[0] = ',';
+  buf += comma;
+  size_t len = single ? json_ftoa(buf, (float)number) : json_dtoa(buf, number);
+  buf[len] = ',';
+  w->cursor = buf + len + trailing_comma(w);
+}
+
+void json_writer_double_unchecked(json_writer_t *w, double number) {
+  real_unchecked(w, number, 0);
+}
+
+void json_writer_float_unchecked(json_writer_t *w, float number) {
+  real_unchecked(w, number, 1);
+}
+
+void json_writer_key_trusted_unchecked(json_writer_t *w, const char *name,
+                                       size_t len) {
+  int comma = key_comma(w);
+
+  STAT_TOKEN(w, JSON_TOKEN_KEY);
+  key_at_cursor(w, name, len, comma);
+}
+
+void json_writer_template_open(json_writer_t *w, const json_template_t *tpl) {
+  if (tpl->count == 0) {
+    open_container(w, NULL, ",{", 1);
+    return;
+  }
+
+  /* {"key0": in one copy, the object is open and its first key written */
+  int comma = value_comma(w);
+
+  if (comma)
+    put_lit(w, ",");
+
+  STAT_TOKEN(w, JSON_TOKEN_OBJECT);
+  STAT_TOKEN(w, JSON_TOKEN_KEY);
+  put(w, tpl->fragments, tpl->offsets[1]);
+  push(w, 1);
+
+  if (!trailing_comma(w))
+    w->state = STATE_KEY;
+}
+
+void json_writer_template_key(json_writer_t *w, const json_template_t *tpl,
+                              size_t field) {
+  if (field >= tpl->count) {
+    fail(w, JSON_ERR_INVALID);
+    return;
+  }
+
+  /* fragments start with the ',' in front of the key, except the first one */
+  int comma = key_comma(w);
+  size_t start = tpl->offsets[field] + 1;
+
+  STAT_TOKEN(w, JSON_TOKEN_KEY);
+
+  if (comma && field == 0)
+    put_lit(w, ",");
+  else
+    start -= comma;
+
+  put(w, tpl->fragments + start, tpl->offsets[field + 1] - start);
+}
+
+int json_template_init(json_template_t *tpl, const char *const *keys,
+                       size_t count, char *fragments, size_t fragments_size,
+                       size_t *offsets) {
+  json_writer_t w;
+
+  json_writer_init(&w, fragments, fragments_size);
+  json_writer_set_options(&w, JSON_WRITER_TRAILING_COMMA);
+
+  for (size_t i = 0; i < count; ++i) {
+    offsets[i] = json_writer_length(&w);
+
+    /* the first key opens the object, the others follow a value */
+    if (i == 0)
+      put_lit(&w, "{");
+    else
+      put_lit(&w, ",");
+
+    key(&w, keys[i]);
+  }
+
+  if (w.error != JSON_OK)
+    return -1;
+
+  offsets[count] = json_writer_length(&w);
+
+  tpl->fragments = fragments;
+  tpl->offsets = offsets;
+  tpl->count = count;
+
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "../include/json_schema.h"
+
+struct sensor {
+  int32_t id;
+  uint64_t ts;
+  double temp;
+  const char *name;
+  int online;
+};
+
+#define SENSOR_FIELDS(F)                                                       \
+  F(int32, id)                                                                 \
+  F(uint64, ts)                                                                \
+  F(double, temp)                                                              \
+  F(str, name)                                                                 \
+  F(bool, online)
+
+JSON_SCHEMA_DEFINE(sensor, struct sensor, SENSOR_FIELDS)
+
+struct limits {
+  int32_t i32;
+  int64_t i64;
+  uint64_t u64;
+  float f;
+  int b;
+};
+
+#define LIMITS_FIELDS(F)                                                       \
+  F(int32, i32)                                                                \
+  F(int64, i64)                                                                \
+  F(uint64, u64)                                                               \
+  F(float, f)                                                                  \
+  F(bool, b)
+
+JSON_SCHEMA_DEFINE(limits, struct limits, LIMITS_FIELDS)
+
+/* json_serialize_ */
+
+static void test_json_schema__serialize(void **state) {
+  const struct sensor sensor = {7, 1700000000123ULL, 21.5, "pro\"be", 1};
+  char json[128] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_serialize_sensor(&w, &sensor);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("{\"id\":7,\"ts\":1700000000123,\"temp\":21.5,"
+                      "\"name\":\"pro\\\"be\",\"online\":true}",
+                      json);
+}
+
+static void test_json_schema__in_array(void **state) {
+  const struct sensor sensors[] = {{1, 2, 0.5, "a", 0}, {3, 4, -1.0, "b", 1}};
+  char json[256] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  for (size_t i = 0; i < 2; ++i)
+    json_serialize_sensor(&w, &sensors[i]);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("[{\"id\":1,\"ts\":2,\"temp\":0.5,\"name\":\"a\","
+                      "\"online\":false},{\"id\":3,\"ts\":4,\"temp\":-1.0,"
+                      "\"name\":\"b\",\"online\":true}]",
+                      json);
+}
+
+/* json_<name>_max_size */
+
+static void test_json_schema__max_size(void **state) {
+  const struct limits limits = {INT32_MIN, INT64_MIN, UINT64_MAX,
+                                -1.17549435e-38f, 0};
+  char json[json_limits_max_size + 1];
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_serialize_limits(&w, &limits);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_true(strlen(json) <= json_limits_max_size);
+}
+
+static void test_json_schema__unchecked_same_output(void **state) {
+  const struct limits limits = {-5, 1, 2, 0.5f, 1};
+  char expected[json_limits_max_size + 1];
+  char json[48];
+  json_writer_t w;
+
+  /* room for the worst case, written unchecked */
+  json_writer_init(&w, expected, sizeof(expected));
+  json_serialize_limits(&w, &limits);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  /* only room for the actual object, written checked */
+  json_writer_init(&w, json, sizeof(json));
+  json_serialize_limits(&w, &limits);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal(expected, json);
+  assert_string_equal("{\"i32\":-5,\"i64\":1,\"u64\":2,\"f\":0.5,\"b\":true}",
+                      json);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_json_schema__serialize),
+      cmocka_unit_test(test_json_schema__in_array),
+
+      cmocka_unit_test(test_json_schema__max_size),
+      cmocka_unit_test(test_json_schema__unchecked_same_output),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,7 +1,12 @@
+#include <float.h>
 #include <limits.h>
+#include <math.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <cmocka.h>
 
@@ -58,7 +63,8 @@ static void test_json_end_obj__close_empty_obj(void **state) {
 
   buf = json_obj_close(buf, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("{},", json);
+  assert_memory_equal("{},", json, 3);
+  assert_ptr_equal(json + 3, buf);
 }
 
 static void test_json_end_obj__close_after_value(void **state) {
@@ -68,7 +74,8 @@ static void test_json_end_obj__close_after_value(void **state) {
 
   buf = json_obj_close(buf, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("{\"test\":42},", json);
+  assert_memory_equal("{\"test\":42},", json, sizeof("{\"test\":42},") - 1);
+  assert_ptr_equal(json + sizeof("{\"test\":42},") - 1, buf);
 }
 
 static void test_json_end_obj__not_enough_space(void **state) {
@@ -136,7 +143,8 @@ static void test_json_arr_close__close_empty(void **state) {
 
   buf = json_arr_close(buf, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("[],", json);
+  assert_memory_equal("[],", json, 3);
+  assert_ptr_equal(json + 3, buf);
 }
 
 static void test_json_arr_close__close_after_value(void **state) {
@@ -146,7 +154,8 @@ static void test_json_arr_close__close_after_value(void **state) {
 
   buf = json_arr_close(buf, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("[true],", json);
+  assert_memory_equal("[true],", json, sizeof("[true],") - 1);
+  assert_ptr_equal(json + sizeof("[true],") - 1, buf);
 }
 
 static void test_json_arr_close__not_enough_space(void **state) {
@@ -379,106 +388,1296 @@ static void test_json_str__escape_tab(void **state) {
   assert_string_equal("\"string with tab (\\t) in it\",", json);
 }
 
+static void test_json_str__escape_control(void **state) {
+  static const char *const shorts = "btn\0fr";
+
+  for (int c = 1; c < 0x20; ++c) {
+    char str[4] = {'a', (char)c, 'b', '\0'};
+    char expected[16];
+    char json[16] = {0};
+    size_t rem_size = sizeof(json);
+
+    if (c >= '\b' && c <= '\r' && c != '\v')
+      snprintf(expected, sizeof(expected), "\"a\\%cb\",", shorts[c - '\b']);
+    else
+      snprintf(expected, sizeof(expected), "\"a\\u%04Xb\",", c);
+
+    assert_non_null(json_str(json, str, &rem_size));
+    assert_string_equal(expected, json);
+  }
+}
+
+static void test_json_str__escape_control_exact_fit(void **state) {
+  // quotes, \u001F, ',' and the null byte
+  char json[2 + 6 + 1 + 1];
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_str(json, "\x1F", &rem_size));
+  assert_memory_equal("\"\\u001F\",", json, 9);
+  assert_int_equal(1, rem_size);
+
+  rem_size = sizeof(json) - 1;
+  assert_null(json_str(json, "\x1F", &rem_size));
+}
+
 static void test_json_str__escape_unicode_2(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_str(buf, "string with unicode (É) in it", &rem_size);
+  buf = json_str(buf, "string with unicode (É) in it", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"string with unicode (\\u00C9) in it\",", json);
+}
+
+static void test_json_str__escape_unicode_3(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_str(buf, "string with unicode (Ⴙ) in it", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"string with unicode (\\u10B9) in it\",", json);
+}
+
+static void test_json_str__escape_unicode_4(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_str(buf, "string with unicode (👍) in it", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"string with unicode (\\uD83D\\uDC4D) in it\",", json);
+}
+
+static void test_json_str__escape_unicode_bounds(void **state) {
+  const char *cases[][2] = {
+      /* 1 byte, copied as is */
+      {"\x7F", "\x7F"},
+      /* 2 bytes */
+      {"\xC2\x80", "\\u0080"},
+      {"\xDF\xBF", "\\u07FF"},
+      /* 3 bytes, around the surrogates */
+      {"\xE0\xA0\x80", "\\u0800"},
+      {"\xED\x9F\xBF", "\\uD7FF"},
+      {"\xEE\x80\x80", "\\uE000"},
+      {"\xEF\xBF\xBF", "\\uFFFF"},
+      /* 4 bytes */
+      {"\xF0\x90\x80\x80", "\\uD800\\uDC00"},
+      {"\xF4\x8F\xBF\xBF", "\\uDBFF\\uDFFF"},
+  };
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    char json[64] = {0};
+    char expected[64];
+    size_t rem_size = sizeof(json);
+
+    snprintf(expected, sizeof(expected), "\"%s\",", cases[i][1]);
+    assert_non_null(json_str(json, cases[i][0], &rem_size));
+    assert_string_equal(expected, json);
+  }
+}
+
+static void test_json_str__escape_unicode_invalid(void **state) {
+  const char *invalid[] = {
+      /* continuation without lead byte */
+      "\x80", "\xBF", "a\x80" "b",
+      /* overlong forms */
+      "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF",
+      "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF",
+      /* utf-16 surrogates */
+      "\xED\xA0\x80", "\xED\xBF\xBF",
+      /* above U+10FFFF, bytes never used */
+      "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8", "\xFE", "\xFF",
+      /* missing continuation, at the end and before another character */
+      "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xC3" "a", "\xE2\x82" "a",
+      "\xF0\x9F\x98" "a", "\xE2\xC3\xA9",
+  };
+
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+    char json[64] = {0};
+    size_t rem_size = sizeof(json);
+
+    assert_null(json_str(json, invalid[i], &rem_size));
+  }
+}
+
+static void test_json_str__escape_unicode_exact_fit(void **state) {
+  // quotes, surrogate pair, ',' and the null byte
+  char json[2 + 12 + 1 + 1];
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_str(json, "\xF0\x9F\x91\x8D", &rem_size));
+  assert_int_equal(1, rem_size);
+
+  rem_size = sizeof(json) - 1;
+  assert_null(json_str(json, "\xF0\x9F\x91\x8D", &rem_size));
+}
+
+static void test_json_str__long_plain_run(void **state) {
+  const char str[] = "a long run of plain ascii characters without escapes";
+  char json[128] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_str(buf, str, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"a long run of plain ascii characters without escapes\",",
+                      json);
+  assert_int_equal(sizeof(json) - (sizeof(str) + 2), rem_size);
+}
+
+static void test_json_str__escape_at_every_offset(void **state) {
+  for (size_t offset = 0; offset < 20; ++offset) {
+    char str[21];
+    char expected[32];
+    char json[64] = {0};
+    char *buf = json;
+    size_t rem_size = sizeof(json);
+
+    memset(str, 'x', 20);
+    str[20] = '\0';
+    str[offset] = '\n';
+
+    memset(expected, 'x', 23);
+    expected[0] = '"';
+    expected[offset + 1] = '\\';
+    expected[offset + 2] = 'n';
+    memcpy(expected + 22, "\",", 3);
+
+    buf = json_str(buf, str, &rem_size);
+    assert_non_null(buf);
+    assert_string_equal(expected, json);
+  }
+}
+
+static void test_json_str__escape_dense(void **state) {
+  const char str[] = "a\"b\\c\nd/e\tf a run longer than a few bytes\x01g\xC3\xA9h";
+  const char expected[] =
+      "\"a\\\"b\\\\c\\nd\\/e\\tf a run longer than a few bytes\\u0001g\\u00E9h\",";
+
+  for (size_t size = sizeof(expected) - 1; size <= sizeof(expected) + 128;
+       ++size) {
+    char json[256] = {0};
+    size_t rem_size = size;
+
+    char *buf = json_str(json, str, &rem_size);
+    if (size == sizeof(expected) - 1) {
+      // one byte short, no room left for the null byte
+      assert_null(buf);
+      continue;
+    }
+
+    assert_non_null(buf);
+    assert_string_equal(expected, json);
+  }
+}
+
+static void test_json_str__not_enough_space_in_run(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = 16;
+
+  buf = json_str(buf, "a long run of plain ascii characters", &rem_size);
+  assert_null(buf);
+}
+
+/* json_strn */
+
+static void test_json_strn__slice(void **state) {
+  const char record[] = "id=42;name=probe;";
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_strn(buf, record + 11, 5, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"probe\",", json);
+  assert_int_equal(sizeof(json) - 8, rem_size);
+}
+
+static void test_json_strn__embedded_null(void **state) {
+  const char packet[] = {'a', '\0', 'b', '\0'};
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_strn(buf, packet, sizeof(packet), &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"a\\u0000b\\u0000\",", json);
+}
+
+static void test_json_strn__empty(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_strn(buf, "not read", 0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"\",", json);
+}
+
+static void test_json_kv_strn__normal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_kv_strn(buf, "mac", "00:11:22:33:44:55 trailing", 17, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"mac\":\"00:11:22:33:44:55\",", json);
+}
+
+/* json_arr_int32 */
+
+static void test_json_arr_int32__normal(void **state) {
+  const int32_t samples[] = {0, -1, 42, INT32_MIN, INT32_MAX};
+  char json[128] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_obj_open(buf, NULL, &rem_size);
+  buf = json_arr_int32(buf, "s", samples, 5, &rem_size);
+  buf = json_arr_int32(buf, "empty", samples, 0, &rem_size);
+  buf = json_obj_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal(
+      "{\"s\":[0,-1,42,-2147483648,2147483647],\"empty\":[]}", json);
+}
+
+static void test_json_arr_int32__same_as_single(void **state) {
+  int32_t samples[1000];
+  char expected[12 * 1000 + 16];
+  char json[12 * 1000 + 16];
+  char *buf = expected;
+  size_t rem_size = sizeof(expected);
+
+  for (size_t i = 0; i < 1000; ++i)
+    samples[i] = (int32_t)(i * 2654435761u);
+
+  buf = json_arr_open(buf, NULL, &rem_size);
+  for (size_t i = 0; i < 1000; ++i)
+    buf = json_int32(buf, samples[i], &rem_size);
+  buf = json_arr_close(buf, &rem_size);
+  size_t expected_rem = rem_size;
+
+  rem_size = sizeof(json);
+  buf = json_arr_int32(json, NULL, samples, 1000, &rem_size);
+  assert_non_null(buf);
+  assert_int_equal(expected_rem, rem_size);
+  assert_memory_equal(expected, json, sizeof(json) - rem_size);
+}
+
+static void test_json_arr_int32__exact_fit(void **state) {
+  const int32_t samples[] = {INT32_MIN, INT32_MIN, INT32_MIN};
+  // 3 numbers of 11 bytes, 2 ',' and the brackets, ',' and the null byte
+  char json[3 * 11 + 2 + 2 + 1 + 1];
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_arr_int32(json, NULL, samples, 3, &rem_size));
+  assert_int_equal(1, rem_size);
+
+  rem_size = sizeof(json) - 1;
+  assert_null(json_arr_int32(json, NULL, samples, 3, &rem_size));
+}
+
+/* json_arr_double */
+
+static void test_json_arr_double__normal(void **state) {
+  const double samples[] = {21.5, -0.1, 1e21, NAN, 3.0};
+  char json[128] = {0};
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_arr_double(json, NULL, samples, 5, &rem_size));
+  assert_string_equal("[21.5,-0.1,1e21,null,3.0],", json);
+}
+
+/* json_arr_bool */
+
+static void test_json_arr_bool__normal(void **state) {
+  const int flags[] = {1, 0, 2, 0};
+  char json[64] = {0};
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_arr_bool(json, "f", flags, 4, &rem_size));
+  assert_string_equal("\"f\":[true,false,true,false],", json);
+}
+
+/* json_base64 */
+
+static void test_json_base64__rfc4648(void **state) {
+  const char *vectors[][2] = {
+      {"", ""},         {"f", "Zg=="},         {"fo", "Zm8="},
+      {"foo", "Zm9v"},  {"foob", "Zm9vYg=="},  {"fooba", "Zm9vYmE="},
+      {"foobar", "Zm9vYmFy"},
+  };
+
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+    char json[32] = {0};
+    char expected[32];
+    size_t rem_size = sizeof(json);
+
+    snprintf(expected, sizeof(expected), "\"%s\",", vectors[i][1]);
+    assert_non_null(
+        json_base64(json, vectors[i][0], strlen(vectors[i][0]), &rem_size));
+    assert_string_equal(expected, json);
+  }
+}
+
+static void test_json_base64__no_escape(void **state) {
+  const unsigned char data[] = {0xFB, 0xFF, 0xBF};
+  char json[16] = {0};
+  size_t rem_size = sizeof(json);
+
+  // '+' and '/' are written as is
+  assert_non_null(json_base64(json, data, sizeof(data), &rem_size));
+  assert_string_equal("\"+/+/\",", json);
+}
+
+static void test_json_base64__exact_fit(void **state) {
+  // quotes, 8 characters, ',' and the null byte
+  char json[2 + 8 + 1 + 1];
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_base64(json, "foobar", 6, &rem_size));
+  assert_int_equal(1, rem_size);
+
+  rem_size = sizeof(json) - 1;
+  assert_null(json_base64(json, "foobar", 6, &rem_size));
+}
+
+/* json_hex */
+
+static void test_json_hex__mac(void **state) {
+  const unsigned char mac[] = {0x00, 0x1A, 0x2B, 0x3C, 0xD4, 0xFF};
+  char json[32] = {0};
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_hex(json, mac, sizeof(mac), &rem_size));
+  assert_string_equal("\"001a2b3cd4ff\",", json);
+}
+
+static void test_json_kv_hex__normal(void **state) {
+  const unsigned char hash[] = {0xDE, 0xAD, 0xBE, 0xEF};
+  char json[32] = {0};
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_kv_hex(json, "sha", hash, sizeof(hash), &rem_size));
+  assert_string_equal("\"sha\":\"deadbeef\",", json);
+}
+
+static void test_json_kv_base64__normal(void **state) {
+  char json[32] = {0};
+  size_t rem_size = sizeof(json);
+
+  assert_non_null(json_kv_base64(json, "blob", "foo", 3, &rem_size));
+  assert_string_equal("\"blob\":\"Zm9v\",", json);
+}
+
+/* json_escape_backend */
+
+static void test_json_escape_backend__scalar_available(void **state) {
+  assert_int_equal(0, json_escape_backend_set(JSON_ESCAPE_SCALAR));
+  assert_int_equal(JSON_ESCAPE_SCALAR, json_escape_backend_get());
+  assert_int_equal(0, json_escape_backend_set(JSON_ESCAPE_AUTO));
+}
+
+static void test_json_escape_backend__auto(void **state) {
+  assert_int_equal(0, json_escape_backend_set(JSON_ESCAPE_AUTO));
+  assert_int_not_equal(JSON_ESCAPE_AUTO, json_escape_backend_get());
+}
+
+static void escape_with_backend(json_escape_backend_t backend, const char *str,
+                                char *json, size_t size) {
+  char *buf = json;
+  size_t rem_size = size;
+
+  assert_int_equal(0, json_escape_backend_set(backend));
+  buf = json_str(buf, str, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+}
+
+static void test_json_escape_backend__identical_output(void **state) {
+  const char *special[] = {"\"", "\\", "/", "\n", "\t", "\x01", "\x1F",
+                           "\x7F", "\xC2\x80", "É", "Ⴙ", "👍"};
+  const size_t nspecial = sizeof(special) / sizeof(*special);
+
+  for (json_escape_backend_t backend = JSON_ESCAPE_SCALAR;
+       backend <= JSON_ESCAPE_NEON; ++backend) {
+    if (json_escape_backend_set(backend))
+      continue;
+
+    // every special character at every offset of a 70 bytes string
+    for (size_t i = 0; i < nspecial; ++i) {
+      for (size_t offset = 0; offset < 70; ++offset) {
+        char str[80];
+        char expected[512];
+        char json[512];
+
+        memset(str, 'x', sizeof(str));
+        memcpy(str + offset, special[i], strlen(special[i]));
+        str[70 + strlen(special[i])] = '\0';
+
+        escape_with_backend(JSON_ESCAPE_SCALAR, str, expected,
+                            sizeof(expected));
+        escape_with_backend(backend, str, json, sizeof(json));
+        assert_string_equal(expected, json);
+      }
+    }
+  }
+
+  assert_int_equal(0, json_escape_backend_set(JSON_ESCAPE_AUTO));
+}
+
+/* json_number */
+
+static void test_json_number__0(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, 0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0,", json);
+}
+
+static void test_json_number__minus_42(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, -42, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-42,", json);
+}
+
+static void test_json_number__42(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, 42, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("42,", json);
+}
+
+static void test_json_number__maxint(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, INT32_MAX, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("2147483647,", json);
+}
+
+static void test_json_number__minint(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, INT32_MIN, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-2147483648,", json);
+}
+
+static void test_json_number__maxlong(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, LONG_MAX, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("9223372036854775807,", json);
+}
+
+static void test_json_number__minlong_minus_one(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, LONG_MIN + 1, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-9223372036854775807,", json);
+}
+
+static void test_json_number__minlong(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_number(buf, LONG_MIN, &rem_size);
+  assert_non_null(buf);
+  if (LONG_MIN == INT64_MIN)
+    assert_string_equal("-9223372036854775808,", json);
+  else
+    assert_string_equal("-2147483648,", json);
+}
+
+static void test_json_number__every_length(void **state) {
+  const char *expected[] = {"9,", "10,", "99,", "100,", "999,", "1000,"};
+  const long numbers[] = {9, 10, 99, 100, 999, 1000};
+
+  for (size_t i = 0; i < sizeof(numbers) / sizeof(*numbers); ++i) {
+    char json[64] = {0};
+    size_t rem_size = sizeof(json);
+
+    assert_non_null(json_number(json, numbers[i], &rem_size));
+    assert_string_equal(expected[i], json);
+    assert_int_equal(sizeof(json) - strlen(expected[i]), rem_size);
+  }
+
+  // every power of ten and the number right before it
+  uint64_t power = 1;
+  for (int digits = 1; digits <= 19; ++digits) {
+    char json[64] = {0};
+    char expected_str[64] = {0};
+    size_t rem_size = sizeof(json);
+
+    power *= 10;
+    expected_str[0] = '1';
+    memset(expected_str + 1, '0', digits);
+    expected_str[digits + 1] = ',';
+
+    assert_non_null(json_uint64(json, power, &rem_size));
+    assert_string_equal(expected_str, json);
+
+    memset(json, 0, sizeof(json));
+    memset(expected_str, 0, sizeof(expected_str));
+    memset(expected_str, '9', digits);
+    expected_str[digits] = ',';
+    rem_size = sizeof(json);
+
+    assert_non_null(json_uint64(json, power - 1, &rem_size));
+    assert_string_equal(expected_str, json);
+  }
+}
+
+static void test_json_number__not_enough_space(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  // "-42," and the null byte do not fit
+  size_t rem_size = 4;
+
+  buf = json_number(buf, -42, &rem_size);
+  assert_null(buf);
+}
+
+static void test_json_number__propagate_error(void **state) {
+  size_t rem_size = 64;
+
+  assert_null(json_number(NULL, 42, &rem_size));
+}
+
+/* json_int64 */
+
+static void test_json_int64__min(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_int64(buf, INT64_MIN, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-9223372036854775808,", json);
+  assert_ptr_equal(json + 21, buf);
+}
+
+static void test_json_int64__max(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_int64(buf, INT64_MAX, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("9223372036854775807,", json);
+}
+
+/* json_uint64 */
+
+static void test_json_uint64__max(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_uint64(buf, UINT64_MAX, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("18446744073709551615,", json);
+}
+
+static void test_json_uint64__0(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_uint64(buf, 0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0,", json);
+}
+
+/* json_int32 */
+
+static void test_json_int32__min(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_int32(buf, INT32_MIN, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-2147483648,", json);
+}
+
+static void test_json_int32__exact_fit(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  // "-2147483648," and the null byte
+  size_t rem_size = 13;
+
+  buf = json_int32(buf, INT32_MIN, &rem_size);
+  assert_non_null(buf);
+  assert_int_equal(1, rem_size);
+}
+
+/* json_double */
+
+static void test_json_double__0_1(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 0.1, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0.1,", json);
+}
+
+static void test_json_double__integral(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 21.0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("21.0,", json);
+}
+
+static void test_json_double__negative_zero(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, -0.0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-0.0,", json);
+}
+
+static void test_json_double__shortest(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 1.0 / 3.0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0.3333333333333333,", json);
+}
+
+static void test_json_double__small(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 0.000001, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0.000001,", json);
+}
+
+static void test_json_double__small_exponent(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 1e-7, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("1e-7,", json);
+}
+
+static void test_json_double__large(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 1e20, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("100000000000000000000.0,", json);
+}
+
+static void test_json_double__large_exponent(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 1.5e21, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("1.5e21,", json);
+}
+
+static void test_json_double__max(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, DBL_MAX, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("1.7976931348623157e308,", json);
+}
+
+static void test_json_double__min_subnormal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, 5e-324, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("5e-324,", json);
+}
+
+static void test_json_double__nan(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, NAN, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("null,", json);
+}
+
+static void test_json_double__infinity(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double(buf, -INFINITY, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("null,", json);
+}
+
+static void test_json_double__not_enough_space(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  // "0.1," and the null byte do not fit
+  size_t rem_size = 4;
+
+  buf = json_double(buf, 0.1, &rem_size);
+  assert_null(buf);
+}
+
+static void test_json_double__propagate_error(void **state) {
+  size_t rem_size = 64;
+
+  assert_null(json_double(NULL, 0.1, &rem_size));
+}
+
+/* json_float */
+
+static void test_json_float__0_1(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_float(buf, 0.1f, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0.1,", json);
+}
+
+static void test_json_float__max(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_float(buf, FLT_MAX, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("3.4028235e38,", json);
+}
+
+static void test_json_float__integral(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_float(buf, 16777216.0f, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("16777216.0,", json);
+}
+
+static void test_json_float__min_subnormal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_float(buf, 1e-45f, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("1e-45,", json);
+}
+
+/* json_double_fixed */
+
+static void test_json_double_fixed__round(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double_fixed(buf, 21.456, 2, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("21.46,", json);
+}
+
+static void test_json_double_fixed__pad(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double_fixed(buf, 0.5, 3, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0.500,", json);
+}
+
+static void test_json_double_fixed__negative(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double_fixed(buf, -3.14159, 2, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("-3.14,", json);
+}
+
+static void test_json_double_fixed__negative_rounds_to_zero(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double_fixed(buf, -0.001, 2, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("0.00,", json);
+}
+
+static void test_json_double_fixed__no_decimals(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double_fixed(buf, 41.6, 0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("42,", json);
+}
+
+static void test_json_double_fixed__out_of_range(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_double_fixed(buf, 1e30, 2, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("1e30,", json);
+}
+
+/* json_key */
+
+static void test_json_key__normal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_key(buf, "temp", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"temp\":", json);
+}
+
+static void test_json_key__escaped(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_key(buf, "a\"b", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"a\\\"b\":", json);
+}
+
+static void test_json_key_trusted__normal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_key_trusted(buf, "temp", 4, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("\"string with unicode (\\u00C9) in it\",", json);
+  assert_string_equal("\"temp\":", json);
 }
 
-static void test_json_str__escape_unicode_3(void **state) {
+static void test_json_key_trusted__literal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_str(buf, "string with unicode (Ⴙ) in it", &rem_size);
+  buf = JSON_KEY(buf, "temp", &rem_size);
   assert_non_null(buf);
-  assert_string_equal("\"string with unicode (\\u10B9) in it\",", json);
+  assert_string_equal("\"temp\":", json);
 }
 
-static void test_json_str__escape_unicode_4(void **state) {
+static void test_json_key_trusted__not_enough_space(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  // "\"temp\":" and the null byte do not fit
+  size_t rem_size = 7;
+
+  buf = json_key_trusted(buf, "temp", 4, &rem_size);
+  assert_null(buf);
+}
+
+static void test_json_key_trusted__propagate_error(void **state) {
+  size_t rem_size = 64;
+
+  assert_null(json_key_trusted(NULL, "temp", 4, &rem_size));
+}
+
+/* json_kv */
+
+static void test_json_kv_str__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_str(buf, "string with unicode (👍) in it", &rem_size);
+  buf = json_kv_str(buf, "name", "a/b", &rem_size);
   assert_non_null(buf);
-  assert_string_equal("\"string with unicode (\\uD83D\\uDC4D) in it\",", json);
+  assert_string_equal("\"name\":\"a\\/b\",", json);
 }
 
-/* json_number */
+static void test_json_kv_number__normal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
 
-static void test_json_number__0(void **state) {
+  buf = json_kv_number(buf, "temp", 21, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"temp\":21,", json);
+}
+
+static void test_json_kv_int64__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, 0, &rem_size);
+  buf = json_kv_int64(buf, "ts", INT64_MIN, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("0,", json);
+  assert_string_equal("\"ts\":-9223372036854775808,", json);
 }
 
-static void test_json_number__minus_42(void **state) {
+static void test_json_kv_uint64__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, -42, &rem_size);
+  buf = json_kv_uint64(buf, "ts", UINT64_MAX, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("-42,", json);
+  assert_string_equal("\"ts\":18446744073709551615,", json);
 }
 
-static void test_json_number__42(void **state) {
+static void test_json_kv_int32__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, 42, &rem_size);
+  buf = json_kv_int32(buf, "id", -7, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("42,", json);
+  assert_string_equal("\"id\":-7,", json);
 }
 
-static void test_json_number__maxint(void **state) {
+static void test_json_kv_double__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, INT32_MAX, &rem_size);
+  buf = json_kv_double(buf, "v", 0.1, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("2147483647,", json);
+  assert_string_equal("\"v\":0.1,", json);
 }
 
-static void test_json_number__minint(void **state) {
+static void test_json_kv_float__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, INT32_MIN, &rem_size);
+  buf = json_kv_float(buf, "v", 0.1f, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("-2147483648,", json);
+  assert_string_equal("\"v\":0.1,", json);
 }
 
-static void test_json_number__maxlong(void **state) {
+static void test_json_kv_double_fixed__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, LONG_MAX, &rem_size);
+  buf = json_kv_double_fixed(buf, "v", 21.456, 1, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("9223372036854775807,", json);
+  assert_string_equal("\"v\":21.5,", json);
 }
 
-static void test_json_number__minlong_minus_one(void **state) {
+static void test_json_kv_bool__normal(void **state) {
   char json[64] = {0};
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  buf = json_number(buf, LONG_MIN + 1, &rem_size);
+  buf = json_kv_bool(buf, "on", 0, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("-9223372036854775807,", json);
+  assert_string_equal("\"on\":false,", json);
+}
+
+static void test_json_kv_null__normal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_kv_null(buf, "none", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"none\":null,", json);
+}
+
+static void test_json_kv_raw__normal(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+  const char cached[] = "{\"mode\":\"eco\",\"rate\":[1,2]}";
+
+  buf = json_kv_raw(buf, "config", cached, sizeof(cached) - 1, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"config\":{\"mode\":\"eco\",\"rate\":[1,2]},", json);
+}
+
+/* json_raw */
+
+static void test_json_raw__in_array(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_arr_open(buf, NULL, &rem_size);
+  buf = json_raw(buf, "[1,2]", 5, &rem_size);
+  buf = json_raw(buf, "\"x\"", 3, &rem_size);
+  buf = json_arr_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("[[1,2],\"x\"]", json);
+}
+
+static void test_json_raw__no_space(void **state) {
+  char json[6] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_raw(buf, "[1,2]", 5, &rem_size);
+  assert_null(buf);
+}
+
+static void test_json_raw__empty(void **state) {
+  char json[16] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  // rejected with or without JSON_VALIDATE_RAW, it would write [,1]
+  buf = json_arr_open(buf, NULL, &rem_size);
+  assert_null(json_raw(buf, "", 0, &rem_size));
+}
+
+#ifdef JSON_VALIDATE_RAW
+static void test_json_raw__invalid(void **state) {
+  const char *invalid[] = {
+      "",        "[1,2",    "{\"a\"}",  "{a:1}",   "01",     "1.",
+      "-",       "1e",      "tru",      "nul",     "[1,]",   "\"\\x\"",
+      "\"\\u12\"", "\"\t\"",   "1 2",      "[1]]",    "{\"a\":}", "+1",
+  };
+
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+    char json[64] = {0};
+    size_t rem_size = sizeof(json);
+
+    assert_null(json_raw(json, invalid[i], strlen(invalid[i]), &rem_size));
+  }
+}
+
+static void test_json_raw__valid(void **state) {
+  const char *valid[] = {
+      "0",     "-0.5e+10", "1E3",   " true ", "null", "false", "\"\\u00e9\\n\"",
+      "[]",    "{ }",      "[{\"a\":[1, {\"b\":null}]}, \"s\"]",
+  };
+
+  for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i) {
+    char json[64] = {0};
+    size_t rem_size = sizeof(json);
+
+    assert_non_null(json_raw(json, valid[i], strlen(valid[i]), &rem_size));
+  }
+}
+#endif
+
+static void test_json_tkv__number(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_tkv_number(buf, "temp", 21, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"temp\":21,", json);
+}
+
+static void test_json_tkv__str(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_tkv_str(buf, "name", "x", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"name\":\"x\",", json);
+}
+
+static void test_json_tkv__bool(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_tkv_bool(buf, "on", 1, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"on\":true,", json);
+}
+
+static void test_json_tkv__null(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_tkv_null(buf, "none", &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"none\":null,", json);
+}
+
+static void test_json_kv__not_enough_space_for_value(void **state) {
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = 9;
+
+  buf = json_kv_number(buf, "temp", 21, &rem_size);
+  assert_null(buf);
+}
+
+static void test_json_kv__propagate_error(void **state) {
+  size_t rem_size = 64;
+
+  assert_null(json_kv_number(NULL, "temp", 21, &rem_size));
+  assert_null(json_tkv_number(NULL, "temp", 21, &rem_size));
+}
+
+/* json_template */
+
+static const char *const template_keys[] = {"id", "ts", "a\"b"};
+
+static void test_json_template_init__fragments(void **state) {
+  json_template_t tpl;
+  char fragments[64];
+  size_t offsets[4];
+
+  assert_int_equal(0, json_template_init(&tpl, template_keys, 3, fragments,
+                                         sizeof(fragments), offsets));
+  assert_int_equal(3, tpl.count);
+  assert_memory_equal("{\"id\":,\"ts\":,\"a\\\"b\":", tpl.fragments,
+                      tpl.offsets[3]);
+  assert_int_equal(0, tpl.offsets[0]);
+  assert_int_equal(6, tpl.offsets[1]);
+  assert_int_equal(12, tpl.offsets[2]);
+}
+
+static void test_json_template_init__not_enough_space(void **state) {
+  json_template_t tpl;
+  char fragments[12];
+  size_t offsets[4];
+
+  assert_int_equal(-1, json_template_init(&tpl, template_keys, 3, fragments,
+                                          sizeof(fragments), offsets));
+}
+
+static void test_json_template__record(void **state) {
+  json_template_t tpl;
+  char fragments[JSON_TEMPLATE_FRAGMENTS_SIZE(3, 7)];
+  size_t offsets[4];
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  assert_int_equal(0, json_template_init(&tpl, template_keys, 3, fragments,
+                                         sizeof(fragments), offsets));
+
+  buf = json_template_open(buf, &tpl, &rem_size);
+  buf = json_int32(buf, 7, &rem_size);
+  buf = json_template_key(buf, &tpl, 1, &rem_size);
+  buf = json_uint64(buf, 1700000000, &rem_size);
+  buf = json_template_key(buf, &tpl, 2, &rem_size);
+  buf = json_null(buf, &rem_size);
+  buf = json_obj_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+
+  assert_string_equal("{\"id\":7,\"ts\":1700000000,\"a\\\"b\":null}", json);
+}
+
+static void test_json_template_key__first(void **state) {
+  json_template_t tpl;
+  char fragments[64];
+  size_t offsets[4];
+  char json[64] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  json_template_init(&tpl, template_keys, 3, fragments, sizeof(fragments),
+                     offsets);
+
+  buf = json_template_key(buf, &tpl, 0, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("\"id\":", json);
+}
+
+static void test_json_template_key__out_of_range(void **state) {
+  json_template_t tpl;
+  char fragments[64];
+  size_t offsets[4];
+  char json[64] = {0};
+  size_t rem_size = sizeof(json);
+
+  json_template_init(&tpl, template_keys, 3, fragments, sizeof(fragments),
+                     offsets);
+
+  assert_null(json_template_key(json, &tpl, 3, &rem_size));
+}
+
+static void test_json_template_open__not_enough_space(void **state) {
+  json_template_t tpl;
+  char fragments[64];
+  size_t offsets[4];
+  char json[64] = {0};
+  size_t rem_size = 6;
+
+  json_template_init(&tpl, template_keys, 3, fragments, sizeof(fragments),
+                     offsets);
+
+  assert_null(json_template_open(json, &tpl, &rem_size));
+}
+
+static void test_json_template__propagate_error(void **state) {
+  json_template_t tpl;
+  char fragments[64];
+  size_t offsets[4];
+  size_t rem_size = 64;
+
+  json_template_init(&tpl, template_keys, 3, fragments, sizeof(fragments),
+                     offsets);
+
+  assert_null(json_template_open(NULL, &tpl, &rem_size));
+  assert_null(json_template_key(NULL, &tpl, 1, &rem_size));
 }
 
 /* json_end */
@@ -496,14 +1695,40 @@ static void test_json_end__normal(void **state) {
 
 static void test_json_end__empty(void **state) {
   char json[64] = "--------------";
+  char *buf = json + 1; // json_end() reads the byte before buf
+  size_t rem_size = sizeof(json) - 1;
+
+  // should null terminate and return an empty string
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+  assert_string_equal("", json + 1);
+  assert_int_equal(sizeof(json) - 1, rem_size);
+}
+
+static void test_json_end__null_terminate_once(void **state) {
+  char json[64] = "------------------------------";
   char *buf = json;
   size_t rem_size = sizeof(json);
 
-  // should null terminate and return an empty string
+  // tokens are not null terminated, json_end writes the only null byte
+  buf = json_arr_open(buf, NULL, &rem_size);
+  buf = json_number(buf, 1, &rem_size);
+  assert_non_null(buf);
+  assert_memory_equal("[1,-", json, 4);
+
+  buf = json_arr_close(buf, &rem_size);
   buf = json_end(buf, &rem_size);
   assert_non_null(buf);
-  assert_string_equal("", json);
-  assert_int_equal(sizeof(json), rem_size);
+  assert_string_equal("[1]", json);
+}
+
+static void test_json_end__not_enough_space(void **state) {
+  char json[64] = "42";
+  char *buf = json + 2;
+  size_t rem_size = 0;
+
+  buf = json_end(buf, &rem_size);
+  assert_null(buf);
 }
 
 static void test_json_end__propagate_error(void **state) {
@@ -516,6 +1741,53 @@ static void test_json_end__propagate_error(void **state) {
   assert_null(buf);
 }
 
+/* JSON_MAX_LEN */
+
+static void test_json_max_len__extremes(void **state) {
+  char json[JSON_MAX_LEN_OPEN + 1 + JSON_MAX_LEN_KEY_LITERAL("n") + 1 +
+            JSON_MAX_LEN_NUMBER + 1 + JSON_MAX_LEN_KEY_LITERAL("u") + 1 +
+            JSON_MAX_LEN_UINT64 + 1 + JSON_MAX_LEN_KEY_LITERAL("d") + 1 +
+            JSON_MAX_LEN_DOUBLE + 1 + JSON_MAX_LEN_KEY_LITERAL("f") + 1 +
+            JSON_MAX_LEN_DOUBLE_FIXED + 1 + JSON_MAX_LEN_CLOSE + 1 + 1];
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_obj_open(buf, NULL, &rem_size);
+  buf = json_tkv_number(buf, "n", LONG_MIN, &rem_size);
+  buf = json_tkv_uint64(buf, "u", UINT64_MAX, &rem_size);
+  buf = json_tkv_double(buf, "d", -1.2345678901234567e-308, &rem_size);
+  buf = json_tkv_double_fixed(buf, "f", -9.9e18, 9, &rem_size);
+  buf = json_obj_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+}
+
+static void test_json_max_len__str(void **state) {
+  const char str[] = "\x01\x02\x03\x04\x05\x06\x07\x0e";
+  char json[JSON_MAX_LEN_STR(sizeof(str) - 1) + 1 + 1];
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_str(buf, str, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+  assert_int_equal(JSON_MAX_LEN_STR(sizeof(str) - 1), strlen(json));
+}
+
+static void test_json_max_len__binary(void **state) {
+  const uint8_t data[] = {0xde, 0xad, 0xbe, 0xef};
+  char json[JSON_MAX_LEN_BASE64(sizeof(data)) + 1 +
+            JSON_MAX_LEN_HEX(sizeof(data)) + 1 + 1];
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_base64(buf, data, sizeof(data), &rem_size);
+  buf = json_hex(buf, data, sizeof(data), &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+  assert_int_equal(sizeof(json) - 2, strlen(json));
+}
+
 /* integration */
 
 static void test_json__empty_object(void **state) {
@@ -548,6 +1820,61 @@ static void test_json__empty_array(void **state) {
   assert_string_equal("[]", json);
 }
 
+static void test_json__nested_exact_fit(void **state) {
+  const char expected[] = "{\"a\":[1,2,3]}";
+  // one more byte for the trailing ',' removed by json_end
+  char json[sizeof(expected) + 1];
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  memset(json, '-', sizeof(json));
+
+  buf = json_obj_open(buf, NULL, &rem_size);
+  buf = json_arr_open(buf, "a", &rem_size);
+  buf = json_number(buf, 1, &rem_size);
+  buf = json_number(buf, 2, &rem_size);
+  buf = json_number(buf, 3, &rem_size);
+  buf = json_arr_close(buf, &rem_size);
+  buf = json_obj_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+
+  assert_string_equal(expected, json);
+  assert_ptr_equal(json + sizeof(expected) - 1, buf);
+}
+
+static void test_json__nested_one_byte_short(void **state) {
+  char json[sizeof("{\"a\":[1,2,3]}")];
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_obj_open(buf, NULL, &rem_size);
+  buf = json_arr_open(buf, "a", &rem_size);
+  buf = json_number(buf, 1, &rem_size);
+  buf = json_number(buf, 2, &rem_size);
+  buf = json_number(buf, 3, &rem_size);
+  buf = json_arr_close(buf, &rem_size);
+  buf = json_obj_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_null(buf);
+}
+
+static void test_json__members(void **state) {
+  char json[128] = {0};
+  char *buf = json;
+  size_t rem_size = sizeof(json);
+
+  buf = json_obj_open(buf, NULL, &rem_size);
+  buf = json_tkv_int32(buf, "id", 7, &rem_size);
+  buf = json_kv_str(buf, "name", "probe", &rem_size);
+  buf = json_kv_double(buf, "temp", 21.5, &rem_size);
+  buf = json_obj_close(buf, &rem_size);
+  buf = json_end(buf, &rem_size);
+  assert_non_null(buf);
+
+  assert_string_equal("{\"id\":7,\"name\":\"probe\",\"temp\":21.5}", json);
+}
+
 int main(void) {
   const struct CMUnitTest tests[] = {
       cmocka_unit_test(test_json_start_obj__unamed),
@@ -596,9 +1923,41 @@ int main(void) {
       cmocka_unit_test(test_json_str__escape_cr),
       cmocka_unit_test(test_json_str__escape_tab),
 
+      cmocka_unit_test(test_json_str__escape_control),
+      cmocka_unit_test(test_json_str__escape_control_exact_fit),
       cmocka_unit_test(test_json_str__escape_unicode_2),
       cmocka_unit_test(test_json_str__escape_unicode_3),
       cmocka_unit_test(test_json_str__escape_unicode_4),
+      cmocka_unit_test(test_json_str__escape_unicode_bounds),
+      cmocka_unit_test(test_json_str__escape_unicode_invalid),
+      cmocka_unit_test(test_json_str__escape_unicode_exact_fit),
+      cmocka_unit_test(test_json_str__long_plain_run),
+
+      cmocka_unit_test(test_json_str__escape_at_every_offset),
+      cmocka_unit_test(test_json_str__escape_dense),
+      cmocka_unit_test(test_json_str__not_enough_space_in_run),
+
+      cmocka_unit_test(test_json_strn__slice),
+      cmocka_unit_test(test_json_strn__embedded_null),
+      cmocka_unit_test(test_json_strn__empty),
+      cmocka_unit_test(test_json_kv_strn__normal),
+
+      cmocka_unit_test(test_json_arr_int32__normal),
+      cmocka_unit_test(test_json_arr_int32__same_as_single),
+      cmocka_unit_test(test_json_arr_int32__exact_fit),
+      cmocka_unit_test(test_json_arr_double__normal),
+      cmocka_unit_test(test_json_arr_bool__normal),
+
+      cmocka_unit_test(test_json_base64__rfc4648),
+      cmocka_unit_test(test_json_base64__no_escape),
+      cmocka_unit_test(test_json_base64__exact_fit),
+      cmocka_unit_test(test_json_hex__mac),
+      cmocka_unit_test(test_json_kv_hex__normal),
+      cmocka_unit_test(test_json_kv_base64__normal),
+
+      cmocka_unit_test(test_json_escape_backend__scalar_available),
+      cmocka_unit_test(test_json_escape_backend__auto),
+      cmocka_unit_test(test_json_escape_backend__identical_output),
 
       cmocka_unit_test(test_json_number__0),
       cmocka_unit_test(test_json_number__minus_42),
@@ -607,13 +1966,103 @@ int main(void) {
       cmocka_unit_test(test_json_number__minint),
       cmocka_unit_test(test_json_number__maxlong),
       cmocka_unit_test(test_json_number__minlong_minus_one),
+      cmocka_unit_test(test_json_number__minlong),
+      cmocka_unit_test(test_json_number__every_length),
+      cmocka_unit_test(test_json_number__not_enough_space),
+      cmocka_unit_test(test_json_number__propagate_error),
+
+      cmocka_unit_test(test_json_int64__min),
+      cmocka_unit_test(test_json_int64__max),
+
+      cmocka_unit_test(test_json_uint64__max),
+      cmocka_unit_test(test_json_uint64__0),
+
+      cmocka_unit_test(test_json_int32__min),
+      cmocka_unit_test(test_json_int32__exact_fit),
+
+      cmocka_unit_test(test_json_double__0_1),
+      cmocka_unit_test(test_json_double__integral),
+      cmocka_unit_test(test_json_double__negative_zero),
+      cmocka_unit_test(test_json_double__shortest),
+      cmocka_unit_test(test_json_double__small),
+      cmocka_unit_test(test_json_double__small_exponent),
+      cmocka_unit_test(test_json_double__large),
+      cmocka_unit_test(test_json_double__large_exponent),
+      cmocka_unit_test(test_json_double__max),
+      cmocka_unit_test(test_json_double__min_subnormal),
+      cmocka_unit_test(test_json_double__nan),
+      cmocka_unit_test(test_json_double__infinity),
+      cmocka_unit_test(test_json_double__not_enough_space),
+      cmocka_unit_test(test_json_double__propagate_error),
+
+      cmocka_unit_test(test_json_float__0_1),
+      cmocka_unit_test(test_json_float__max),
+      cmocka_unit_test(test_json_float__integral),
+      cmocka_unit_test(test_json_float__min_subnormal),
+
+      cmocka_unit_test(test_json_double_fixed__round),
+      cmocka_unit_test(test_json_double_fixed__pad),
+      cmocka_unit_test(test_json_double_fixed__negative),
+      cmocka_unit_test(test_json_double_fixed__negative_rounds_to_zero),
+      cmocka_unit_test(test_json_double_fixed__no_decimals),
+      cmocka_unit_test(test_json_double_fixed__out_of_range),
+
+      cmocka_unit_test(test_json_key__normal),
+      cmocka_unit_test(test_json_key__escaped),
+      cmocka_unit_test(test_json_key_trusted__normal),
+      cmocka_unit_test(test_json_key_trusted__literal),
+      cmocka_unit_test(test_json_key_trusted__not_enough_space),
+      cmocka_unit_test(test_json_key_trusted__propagate_error),
+
+      cmocka_unit_test(test_json_kv_str__normal),
+      cmocka_unit_test(test_json_kv_number__normal),
+      cmocka_unit_test(test_json_kv_int64__normal),
+      cmocka_unit_test(test_json_kv_uint64__normal),
+      cmocka_unit_test(test_json_kv_int32__normal),
+      cmocka_unit_test(test_json_kv_double__normal),
+      cmocka_unit_test(test_json_kv_float__normal),
+      cmocka_unit_test(test_json_kv_double_fixed__normal),
+      cmocka_unit_test(test_json_kv_bool__normal),
+      cmocka_unit_test(test_json_kv_null__normal),
+      cmocka_unit_test(test_json_kv_raw__normal),
+
+      cmocka_unit_test(test_json_raw__in_array),
+      cmocka_unit_test(test_json_raw__no_space),
+      cmocka_unit_test(test_json_raw__empty),
+#ifdef JSON_VALIDATE_RAW
+      cmocka_unit_test(test_json_raw__invalid),
+      cmocka_unit_test(test_json_raw__valid),
+#endif
+      cmocka_unit_test(test_json_tkv__number),
+      cmocka_unit_test(test_json_tkv__str),
+      cmocka_unit_test(test_json_tkv__bool),
+      cmocka_unit_test(test_json_tkv__null),
+      cmocka_unit_test(test_json_kv__not_enough_space_for_value),
+      cmocka_unit_test(test_json_kv__propagate_error),
+
+      cmocka_unit_test(test_json_template_init__fragments),
+      cmocka_unit_test(test_json_template_init__not_enough_space),
+      cmocka_unit_test(test_json_template__record),
+      cmocka_unit_test(test_json_template_key__first),
+      cmocka_unit_test(test_json_template_key__out_of_range),
+      cmocka_unit_test(test_json_template_open__not_enough_space),
+      cmocka_unit_test(test_json_template__propagate_error),
 
       cmocka_unit_test(test_json_end__normal),
       cmocka_unit_test(test_json_end__empty),
+      cmocka_unit_test(test_json_end__null_terminate_once),
+      cmocka_unit_test(test_json_end__not_enough_space),
       cmocka_unit_test(test_json_end__propagate_error),
 
+      cmocka_unit_test(test_json_max_len__extremes),
+      cmocka_unit_test(test_json_max_len__str),
+      cmocka_unit_test(test_json_max_len__binary),
+
       cmocka_unit_test(test_json__empty_object),
       cmocka_unit_test(test_json__empty_array),
+      cmocka_unit_test(test_json__nested_exact_fit),
+      cmocka_unit_test(test_json__nested_one_byte_short),
+      cmocka_unit_test(test_json__members),
   };
 
   return cmocka_run_group_tests(tests, NULL, NULL);
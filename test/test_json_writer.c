@@ -0,0 +1,1129 @@
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "../include/json_writer.h"
+
+/* json_writer_init */
+
+static void test_json_writer_init__empty(void **state) {
+  char json[16] = "--------------";
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("", json);
+  assert_int_equal(0, json_writer_length(&w));
+}
+
+static void test_json_writer_init__zero_size(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, 0);
+  json_writer_true(&w);
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+}
+
+static void test_json_writer_init__null_buffer(void **state) {
+  json_writer_t w;
+
+  json_writer_init(&w, NULL, 16);
+  json_writer_true(&w);
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+}
+
+/* json_writer_finish */
+
+static void test_json_writer_finish__document(void **state) {
+  char json[128];
+  json_writer_t w;
+
+  memset(json, '-', sizeof(json));
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_int32(&w, "id", 7);
+  json_writer_kv_str(&w, "name", "probe");
+  json_writer_arr_open(&w, "values");
+  json_writer_double(&w, 21.5);
+  json_writer_null(&w);
+  json_writer_bool(&w, 1);
+  json_writer_arr_close(&w);
+  json_writer_obj_open(&w, "empty");
+  json_writer_obj_close(&w);
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  assert_string_equal("{\"id\":7,\"name\":\"probe\",\"values\":[21.5,null,true],"
+                      "\"empty\":{}}",
+                      json);
+  assert_int_equal(strlen(json), json_writer_length(&w));
+}
+
+static void test_json_writer_finish__exact_fit(void **state) {
+  // "[1]" and the null byte, no ',' is written to be removed later
+  char json[4];
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_int32(&w, 1);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("[1]", json);
+}
+
+static void test_json_writer_finish__one_byte_short(void **state) {
+  char json[3];
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_int32(&w, 1);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+}
+
+static void test_json_writer_finish__unclosed(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_finish__dangling_key(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  json_writer_key(&w, "a");
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_finish__top_level_values(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  // a document has a single root value
+  json_writer_int32(&w, 1);
+  json_writer_str(&w, "a");
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_finish__top_level_after_container(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_arr_close(&w);
+  json_writer_obj_open(&w, NULL);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+/* json_writer_init_stream */
+
+struct sink {
+  char data[2048];
+  size_t len;
+  int calls;
+  int fail_at;
+};
+
+static int sink_flush(void *ctx, const char *data, size_t len) {
+  struct sink *sink = ctx;
+
+  if (++sink->calls == sink->fail_at)
+    return -1;
+
+  assert_true(len > 0);
+  assert_true(sink->len + len <= sizeof(sink->data));
+  memcpy(sink->data + sink->len, data, len);
+  sink->len += len;
+  return 0;
+}
+
+static void write_document(json_writer_t *w) {
+  json_writer_arr_open(w, NULL);
+  for (int i = 0; i < 8; ++i) {
+    json_writer_obj_open(w, NULL);
+    json_writer_kv_int64(w, "id", INT64_MIN + i);
+    JSON_WRITER_KEY(w, "a key longer than the thirty two bytes chunk");
+    json_writer_str(w, "\"quoted\" value");
+    json_writer_obj_close(w);
+  }
+  json_writer_arr_close(w);
+}
+
+static void test_json_writer_init_stream__same_output(void **state) {
+  char expected[1024];
+  char chunk[JSON_WRITER_MIN_CHUNK];
+  struct sink sink = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, expected, sizeof(expected));
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  json_writer_init_stream(&w, chunk, sizeof(chunk), sink_flush, &sink);
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  assert_int_equal(strlen(expected), sink.len);
+  assert_memory_equal(expected, sink.data, sink.len);
+  assert_int_equal(sink.len, json_writer_length(&w));
+  assert_true(sink.calls > 1);
+}
+
+static void test_json_writer_init_stream__binary(void **state) {
+  unsigned char data[200];
+  char expected[1024];
+  char chunk[JSON_WRITER_MIN_CHUNK];
+  struct sink sink = {0};
+  json_writer_t w;
+
+  for (size_t i = 0; i < sizeof(data); ++i)
+    data[i] = (unsigned char)(i * 7);
+
+  // encoded at once in the buffer, and by blocks through the chunk
+  json_writer_init(&w, expected, sizeof(expected));
+  json_writer_arr_open(&w, NULL);
+  json_writer_base64(&w, data, sizeof(data));
+  json_writer_hex(&w, data, sizeof(data));
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  json_writer_init_stream(&w, chunk, sizeof(chunk), sink_flush, &sink);
+  json_writer_arr_open(&w, NULL);
+  json_writer_base64(&w, data, sizeof(data));
+  json_writer_hex(&w, data, sizeof(data));
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  assert_int_equal(strlen(expected), sink.len);
+  assert_memory_equal(expected, sink.data, sink.len);
+}
+
+static void test_json_writer_init_stream__typed_arrays(void **state) {
+  int32_t ints[100];
+  double doubles[20];
+  int bools[50];
+  char expected[2048];
+  char chunk[JSON_WRITER_MIN_CHUNK];
+  struct sink sink = {0};
+  json_writer_t w;
+
+  for (int i = 0; i < 100; ++i)
+    ints[i] = i * i * (i & 1 ? -1 : 1);
+  for (int i = 0; i < 20; ++i)
+    doubles[i] = i / 3.0;
+  for (int i = 0; i < 50; ++i)
+    bools[i] = i % 3;
+
+  // batches in the buffer, one by one when the chunk is nearly full
+  json_writer_init(&w, expected, sizeof(expected));
+  json_writer_arr_open(&w, NULL);
+  json_writer_arr_int32(&w, NULL, ints, 100);
+  json_writer_arr_double(&w, NULL, doubles, 20);
+  json_writer_arr_bool(&w, NULL, bools, 50);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  json_writer_init_stream(&w, chunk, sizeof(chunk), sink_flush, &sink);
+  json_writer_arr_open(&w, NULL);
+  json_writer_arr_int32(&w, NULL, ints, 100);
+  json_writer_arr_double(&w, NULL, doubles, 20);
+  json_writer_arr_bool(&w, NULL, bools, 50);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  assert_int_equal(strlen(expected), sink.len);
+  assert_memory_equal(expected, sink.data, sink.len);
+}
+
+static void test_json_writer_init_stream__flush_error(void **state) {
+  char chunk[JSON_WRITER_MIN_CHUNK];
+  struct sink sink = {.fail_at = 2};
+  json_writer_t w;
+
+  json_writer_init_stream(&w, chunk, sizeof(chunk), sink_flush, &sink);
+  write_document(&w);
+  assert_int_equal(JSON_ERR_FLUSH, json_writer_finish(&w));
+  assert_int_equal(2, sink.calls);
+}
+
+static void test_json_writer_init_stream__small_chunk(void **state) {
+  char chunk[JSON_WRITER_MIN_CHUNK - 1];
+  struct sink sink = {0};
+  json_writer_t w;
+
+  json_writer_init_stream(&w, chunk, sizeof(chunk), sink_flush, &sink);
+  json_writer_true(&w);
+  assert_int_equal(JSON_ERR_INVALID, json_writer_finish(&w));
+  assert_int_equal(0, sink.calls);
+}
+
+/* json_writer_init_growable */
+
+struct pool {
+  char memory[2048];
+  size_t used;
+  int calls;
+};
+
+/* bump allocator, the last block grows in place */
+static void *pool_resize(void *ctx, void *ptr, size_t old_size,
+                         size_t new_size) {
+  struct pool *pool = ctx;
+
+  ++pool->calls;
+  if (new_size == 0)
+    return NULL;
+
+  if (ptr)
+    pool->used -= old_size;
+  if (pool->used + new_size > sizeof(pool->memory))
+    return NULL;
+
+  char *block = pool->memory + pool->used;
+  pool->used += new_size;
+  return block;
+}
+
+static void test_json_writer_init_growable__same_output(void **state) {
+  char expected[1024];
+  json_writer_t w;
+  size_t size;
+
+  json_writer_init(&w, expected, sizeof(expected));
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  json_writer_init_growable(&w, 0, NULL, NULL);
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(strlen(expected), json_writer_length(&w));
+
+  char *json = json_writer_release(&w, &size);
+  assert_non_null(json);
+  assert_string_equal(expected, json);
+  assert_true(size > strlen(expected));
+
+  // released, the writer does not free the buffer anymore
+  json_writer_dispose(&w);
+  free(json);
+}
+
+static void test_json_writer_init_growable__doubling(void **state) {
+  struct pool pool = {0};
+  json_writer_t w;
+
+  json_writer_init_growable(&w, JSON_WRITER_MIN_CHUNK, pool_resize, &pool);
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  // 32 to 1024 bytes, the first long key skips 64
+  assert_int_equal(5, pool.calls);
+  assert_int_equal(1024, w.capacity);
+
+  json_writer_dispose(&w);
+  assert_int_equal(6, pool.calls);
+}
+
+static void test_json_writer_init_growable__alloc_error(void **state) {
+  struct pool pool = {.used = 2048 - 256};
+  json_writer_t w;
+  size_t size;
+
+  json_writer_init_growable(&w, 0, pool_resize, &pool);
+  write_document(&w);
+  assert_int_equal(JSON_ERR_ALLOC, json_writer_finish(&w));
+  assert_null(json_writer_release(&w, &size));
+  json_writer_dispose(&w);
+}
+
+static void test_json_writer_init_growable__initial_alloc_error(void **state) {
+  struct pool pool = {.used = 2048};
+  json_writer_t w;
+  size_t size;
+
+  // not even the first chunk is allocated
+  json_writer_init_growable(&w, 0, pool_resize, &pool);
+  json_writer_int32(&w, 1);
+  assert_int_equal(JSON_ERR_ALLOC, json_writer_finish(&w));
+  assert_int_equal(1, pool.calls);
+  assert_null(json_writer_release(&w, &size));
+  json_writer_dispose(&w);
+  assert_int_equal(1, pool.calls);
+}
+
+static void test_json_writer_release__finish_after_release(void **state) {
+  struct pool pool = {0};
+  json_writer_t w;
+  size_t size;
+
+  json_writer_init_growable(&w, 0, pool_resize, &pool);
+  json_writer_int32(&w, 42);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  char *json = json_writer_release(&w, &size);
+  assert_non_null(json);
+  assert_string_equal("42", json);
+
+  // the document was taken, nothing left to report
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("42", json);
+
+  // a second root value, it is not written anywhere
+  json_writer_int32(&w, 1);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+  assert_string_equal("42", json);
+}
+
+static void test_json_writer_release__not_growable(void **state) {
+  char json[16];
+  json_writer_t w;
+  size_t size;
+
+  json_writer_init(&w, json, sizeof(json));
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_null(json_writer_release(&w, &size));
+}
+
+/* json_writer_init_iovec */
+
+static size_t gather(const json_iovec_t *iov, size_t count, char *out) {
+  size_t len = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(out + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  out[len] = '\0';
+  return len;
+}
+
+static void test_json_writer_init_iovec__reference(void **state) {
+  char blob[200];
+  char staging[64];
+  json_iovec_t iov[8];
+  char json[256];
+  json_writer_t w;
+
+  memset(blob, 'x', sizeof(blob) - 1);
+  blob[sizeof(blob) - 1] = '\0';
+  blob[100] = '\n';
+
+  json_writer_init_iovec(&w, staging, sizeof(staging), iov, 8);
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_int32(&w, "id", 1);
+  json_writer_kv_str(&w, "blob", blob);
+  json_writer_kv_str(&w, "short", "copied");
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  // staging, blob before '\n', staging, blob after '\n', staging
+  assert_int_equal(5, json_writer_iov_count(&w));
+  assert_ptr_equal(blob, iov[1].iov_base);
+  assert_int_equal(100, iov[1].iov_len);
+  assert_ptr_equal(blob + 101, iov[3].iov_base);
+  assert_int_equal(98, iov[3].iov_len);
+
+  size_t len = gather(iov, json_writer_iov_count(&w), json);
+  assert_int_equal(len, json_writer_length(&w));
+  assert_memory_equal("{\"id\":1,\"blob\":\"xxx", json, 17);
+  assert_memory_equal("x\\nx", json + 16 + 99, 4);
+  assert_string_equal("\",\"short\":\"copied\"}", json + len - 19);
+}
+
+static void test_json_writer_init_iovec__entries_full(void **state) {
+  char blob[100];
+  char staging[64];
+  json_iovec_t iov[2];
+  json_writer_t w;
+
+  memset(blob, 'x', sizeof(blob) - 1);
+  blob[sizeof(blob) - 1] = '\0';
+
+  json_writer_init_iovec(&w, staging, sizeof(staging), iov, 2);
+  json_writer_arr_open(&w, NULL);
+  json_writer_str(&w, blob);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+}
+
+static void test_json_writer_init_iovec__raw(void **state) {
+  char cached[128];
+  char staging[32];
+  json_iovec_t iov[4];
+  json_writer_t w;
+
+  memset(cached, '1', sizeof(cached));
+  cached[0] = '[';
+  for (size_t i = 2; i < sizeof(cached) - 2; i += 2)
+    cached[i] = ',';
+  cached[sizeof(cached) - 1] = ']';
+
+  json_writer_init_iovec(&w, staging, sizeof(staging), iov, 4);
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_raw(&w, "cached", cached, sizeof(cached));
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  assert_int_equal(3, json_writer_iov_count(&w));
+  assert_ptr_equal(cached, iov[1].iov_base);
+  assert_int_equal(sizeof(cached), iov[1].iov_len);
+}
+
+/* json_writer_init_measure */
+
+static void write_escapes(json_writer_t *w) {
+  const char *text = "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\t\"\\/\x01";
+
+  json_writer_obj_open(w, NULL);
+  json_writer_kv_str(w, text, text);
+  json_writer_kv_double(w, "d", 0.1);
+  json_writer_kv_double_fixed(w, "f", -2.5, 3);
+  json_writer_arr_open(w, text);
+  json_writer_uint64(w, UINT64_MAX);
+  json_writer_false(w);
+  json_writer_arr_close(w);
+  json_writer_obj_close(w);
+}
+
+static void test_json_writer_init_measure__exact_length(void **state) {
+  char json[256];
+  json_writer_t w;
+
+  json_writer_init_measure(&w);
+  write_escapes(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  size_t measured = json_writer_length(&w);
+
+  json_writer_init(&w, json, sizeof(json));
+  write_escapes(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(strlen(json), measured);
+}
+
+static void write_long_escapes(json_writer_t *w) {
+  const char *parts[] = {"a plain run longer than the scanner minimum",
+                         "\t\"\\/\x01", "short\nruns\rbetween\x1f",
+                         "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"};
+  char text[1024];
+  size_t len = 0;
+
+  for (size_t i = 0; len + 64 < sizeof(text); ++i) {
+    const char *part = parts[(i * 7) % 4];
+
+    memcpy(text + len, part, strlen(part));
+    len += strlen(part);
+  }
+
+  json_writer_arr_open(w, NULL);
+  json_writer_strn(w, text, len);
+  json_writer_arr_close(w);
+}
+
+static void test_json_writer_init_measure__long_string(void **state) {
+  static char json[8192];
+  json_writer_t w;
+
+  json_writer_init_measure(&w);
+  write_long_escapes(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  size_t measured = json_writer_length(&w);
+
+  json_writer_init(&w, json, sizeof(json));
+  write_long_escapes(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(strlen(json), measured);
+
+  // options copying bytes as is
+  unsigned int options = JSON_WRITER_UTF8_RAW | JSON_WRITER_SOLIDUS_RAW |
+                         JSON_WRITER_CONTROL_RAW;
+
+  json_writer_init_measure(&w);
+  json_writer_set_options(&w, options);
+  write_long_escapes(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  measured = json_writer_length(&w);
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_set_options(&w, options);
+  write_long_escapes(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(strlen(json), measured);
+}
+
+static void write_binary(json_writer_t *w) {
+  static unsigned char data[1000];
+
+  json_writer_arr_open(w, NULL);
+  for (size_t len = 0; len <= 4; ++len) {
+    json_writer_base64(w, data, len);
+    json_writer_hex(w, data, len);
+  }
+  json_writer_base64(w, data, sizeof(data));
+  json_writer_hex(w, data, sizeof(data));
+  json_writer_arr_close(w);
+}
+
+static void test_json_writer_init_measure__binary(void **state) {
+  static char json[8192];
+  json_writer_t w;
+
+  // counted from the data length, nothing is encoded
+  json_writer_init_measure(&w);
+  write_binary(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  size_t measured = json_writer_length(&w);
+
+  json_writer_init(&w, json, sizeof(json));
+  write_binary(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(strlen(json), measured);
+}
+
+static void test_json_writer_init_measure__error(void **state) {
+  json_writer_t w;
+
+  json_writer_init_measure(&w);
+  json_writer_str(&w, "\xe2\x82");
+  assert_int_equal(JSON_ERR_UTF8, json_writer_finish(&w));
+
+  json_writer_init_measure(&w);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_init_measure__exact_fit(void **state) {
+  json_writer_t w;
+
+  json_writer_init_measure(&w);
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  size_t size = json_writer_length(&w) + 1;
+  char *json = malloc(size);
+
+  json_writer_init(&w, json, size);
+  write_document(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(size - 1, strlen(json));
+
+  json_writer_init(&w, json, size - 1);
+  write_document(&w);
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+  free(json);
+}
+
+/* nesting */
+
+static void test_json_writer_nesting__commas(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_arr_open(&w, NULL);
+  json_writer_arr_close(&w);
+  json_writer_obj_open(&w, NULL);
+  json_writer_obj_close(&w);
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_bool(&w, "a", 1);
+  JSON_WRITER_KEY(&w, "b");
+  json_writer_arr_open(&w, NULL);
+  json_writer_null(&w);
+  json_writer_int64(&w, -1);
+  json_writer_arr_close(&w);
+  json_writer_obj_close(&w);
+  json_writer_float(&w, 0.5f);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("[[],{},{\"a\":true,\"b\":[null,-1]},0.5]", json);
+}
+
+static void test_json_writer_nesting__mismatched_close(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_nesting__close_nothing_open(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+  // nothing was written before the buffer
+  assert_int_equal(0, json_writer_length(&w));
+}
+
+static void test_json_writer_nesting__value_without_key(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  json_writer_true(&w);
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_nesting__key_in_array(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_kv_null(&w, "a");
+  assert_int_equal(JSON_ERR_NESTING, json_writer_finish(&w));
+}
+
+static void test_json_writer_nesting__max_depth(void **state) {
+  char json[256] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  for (int i = 0; i < JSON_WRITER_MAX_DEPTH; ++i)
+    json_writer_arr_open(&w, NULL);
+  assert_int_equal(JSON_OK, w.error);
+
+  for (int i = 0; i < JSON_WRITER_MAX_DEPTH; ++i)
+    json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  json_writer_init(&w, json, sizeof(json));
+  for (int i = 0; i <= JSON_WRITER_MAX_DEPTH; ++i)
+    json_writer_arr_open(&w, NULL);
+  assert_int_equal(JSON_ERR_DEPTH, json_writer_finish(&w));
+}
+
+static void test_json_writer_nesting__trailing_comma(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_set_options(&w, JSON_WRITER_TRAILING_COMMA);
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_int32(&w, "a", 1);
+  json_writer_obj_close(&w);
+  assert_memory_equal("{\"a\":1},", json, 9);
+
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("{\"a\":1}", json);
+}
+
+/* options */
+
+static void test_json_writer_options__utf8_raw(void **state) {
+  const char *text = "\xe6\x97\xa5\xe6\x9c\xac \xc3\xa9t\xc3\xa9 \xf0\x9f\x91\x8d";
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_set_options(&w, JSON_WRITER_UTF8_RAW);
+  json_writer_str(&w, text);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(strlen(text) + 2, strlen(json));
+  assert_memory_equal(text, json + 1, strlen(text));
+}
+
+static void test_json_writer_options__utf8_raw_invalid(void **state) {
+  const char *invalid[] = {"\x80", "\xC0\x80", "\xED\xA0\x80", "a\xE2\x82",
+                           "\xE2\x82" "a", "\xC3\xA9\xFF"};
+  char json[64] = {0};
+  json_writer_t w;
+
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+    json_writer_init(&w, json, sizeof(json));
+    json_writer_set_options(&w, JSON_WRITER_UTF8_RAW);
+    json_writer_str(&w, invalid[i]);
+    assert_int_equal(JSON_ERR_UTF8, json_writer_finish(&w));
+  }
+
+  // not validated, copied as is
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_set_options(&w,
+                          JSON_WRITER_UTF8_RAW | JSON_WRITER_UTF8_UNCHECKED);
+  json_writer_str(&w, "\xC3\xA9\xFF");
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("\"\xC3\xA9\xFF\"", json);
+}
+
+static void test_json_writer_options__solidus_raw(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_set_options(&w, JSON_WRITER_SOLIDUS_RAW);
+  json_writer_str(&w, "a/b\n");
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("\"a/b\\n\"", json);
+}
+
+static void test_json_writer_options__control_raw(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_set_options(&w, JSON_WRITER_CONTROL_RAW);
+  json_writer_str(&w, "a/b\n\"");
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("\"a\\/b\n\\\"\"", json);
+}
+
+/* json_writer_stats */
+
+#ifdef JSON_WRITER_STATS
+static void test_json_writer_stats__counters(void **state) {
+  const int32_t samples[] = {1, 2, 3};
+  char json[128] = {0};
+  json_writer_t w;
+  json_writer_stats_t stats;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  json_writer_kv_str(&w, "s", "a\"b\xc3\xa9\x01");
+  json_writer_arr_int32(&w, "n", samples, 3);
+  json_writer_obj_open(&w, "o");
+  json_writer_kv_bool(&w, "t", 1);
+  json_writer_kv_null(&w, "z");
+  json_writer_obj_close(&w);
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  assert_int_equal(0, json_writer_stats(&w, &stats));
+  assert_int_equal(strlen(json), stats.bytes);
+  assert_int_equal(2, stats.tokens[JSON_TOKEN_OBJECT]);
+  assert_int_equal(1, stats.tokens[JSON_TOKEN_ARRAY]);
+  assert_int_equal(5, stats.tokens[JSON_TOKEN_KEY]);
+  assert_int_equal(1, stats.tokens[JSON_TOKEN_STRING]);
+  assert_int_equal(3, stats.tokens[JSON_TOKEN_NUMBER]);
+  assert_int_equal(1, stats.tokens[JSON_TOKEN_BOOL]);
+  assert_int_equal(1, stats.tokens[JSON_TOKEN_NULL]);
+  assert_int_equal(3, stats.escapes);
+  assert_int_equal(1, stats.unicode);
+  assert_int_equal(2, stats.peak_depth);
+}
+
+static void test_json_writer_stats__overflow_offset(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+  json_writer_stats_t stats;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_str(&w, "0123");
+  json_writer_str(&w, "too long for the rest");
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+
+  json_writer_stats(&w, &stats);
+  // '[' and the first string, then the opening quote of the second one
+  assert_int_equal(9, stats.overflow_offset);
+}
+#else
+static void test_json_writer_stats__disabled(void **state) {
+  char json[16];
+  json_writer_t w;
+  json_writer_stats_t stats;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_true(&w);
+  assert_int_equal(-1, json_writer_stats(&w, &stats));
+  assert_int_equal(0, stats.bytes);
+}
+#endif
+
+/* error */
+
+static void test_json_writer_error__sticky(void **state) {
+  char json[8] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_str(&w, "too long for the buffer");
+  assert_int_equal(JSON_ERR_NO_SPACE, w.error);
+
+  // following calls are ignored, even the ones that would fit
+  size_t length = json_writer_length(&w);
+  json_writer_true(&w);
+  json_writer_arr_close(&w);
+  assert_int_equal(length, json_writer_length(&w));
+
+  assert_int_equal(JSON_ERR_NO_SPACE, json_writer_finish(&w));
+}
+
+static void test_json_writer_error__first_kept(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+  json_template_t tpl;
+  const char *keys[] = {"id"};
+  char fragments[16];
+  size_t offsets[2];
+
+  json_template_init(&tpl, keys, 1, fragments, sizeof(fragments), offsets);
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_template_key(&w, &tpl, 1);
+  json_writer_str(&w, "a string longer than the sixty four bytes of the "
+                      "output buffer");
+  assert_int_equal(JSON_ERR_INVALID, json_writer_finish(&w));
+}
+
+/* depth */
+
+static void test_json_writer_depth__nested(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  json_writer_arr_open(&w, "a");
+  assert_int_equal(2, w.depth);
+  json_writer_arr_close(&w);
+  assert_int_equal(1, w.depth);
+  json_writer_obj_close(&w);
+  assert_int_equal(0, w.depth);
+}
+
+/* json_writer_reserve */
+
+static void test_json_writer_reserve__unchecked(void **state) {
+  char json[128] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  assert_true(json_writer_reserve(
+      &w, 4 * (1 + JSON_MAX_LEN_KEY_LITERAL("x")) + 1 + JSON_MAX_LEN_INT64 +
+              1 + JSON_MAX_LEN_UINT64 + 1 + JSON_MAX_LEN_DOUBLE + 1 +
+              JSON_MAX_LEN_BOOL));
+  JSON_WRITER_KEY_UNCHECKED(&w, "i");
+  json_writer_int64_unchecked(&w, INT64_MIN);
+  JSON_WRITER_KEY_UNCHECKED(&w, "u");
+  json_writer_uint64_unchecked(&w, UINT64_MAX);
+  JSON_WRITER_KEY_UNCHECKED(&w, "d");
+  json_writer_double_unchecked(&w, 0.1);
+  JSON_WRITER_KEY_UNCHECKED(&w, "b");
+  json_writer_bool_unchecked(&w, 0);
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("{\"i\":-9223372036854775808,"
+                      "\"u\":18446744073709551615,\"d\":0.1,\"b\":false}",
+                      json);
+}
+
+static void test_json_writer_reserve__same_output(void **state) {
+  char expected[64] = {0};
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, expected, sizeof(expected));
+  json_writer_arr_open(&w, NULL);
+  json_writer_int32(&w, -1);
+  json_writer_float(&w, 1.5f);
+  json_writer_true(&w);
+  json_writer_null(&w);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  assert_true(json_writer_reserve(&w, 32));
+  json_writer_int32_unchecked(&w, -1);
+  json_writer_float_unchecked(&w, 1.5f);
+  json_writer_bool_unchecked(&w, 1);
+  json_writer_null_unchecked(&w);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal(expected, json);
+}
+
+static void test_json_writer_reserve__not_enough_room(void **state) {
+  char json[16] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  assert_false(json_writer_reserve(&w, 2 * (1 + JSON_MAX_LEN_INT64)));
+  assert_int_equal(JSON_OK, w.error);
+
+  /* the actual tokens still fit */
+  json_writer_int64(&w, 1);
+  json_writer_int64(&w, 2);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("[1,2]", json);
+}
+
+static void test_json_writer_reserve__stream(void **state) {
+  char chunk[2 * JSON_WRITER_MIN_CHUNK];
+  struct sink sink = {0};
+  json_writer_t w;
+
+  json_writer_init_stream(&w, chunk, sizeof(chunk), sink_flush, &sink);
+  json_writer_arr_open(&w, NULL);
+
+  for (int i = 0; i < 8; ++i) {
+    assert_true(json_writer_reserve(&w, 1 + JSON_MAX_LEN_INT64));
+    json_writer_int64_unchecked(&w, INT64_MAX);
+  }
+
+  assert_false(json_writer_reserve(&w, sizeof(chunk)));
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(2 + 8 * 19 + 7, sink.len);
+  assert_memory_equal("[9223372036854775807,9223372036854775807,", sink.data,
+                      41);
+}
+
+static void test_json_writer_reserve__measure(void **state) {
+  json_writer_t w;
+
+  json_writer_init_measure(&w);
+  json_writer_arr_open(&w, NULL);
+  assert_false(json_writer_reserve(&w, 8));
+  json_writer_int64(&w, 42);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_int_equal(4, json_writer_length(&w));
+}
+
+/* keys */
+
+static void test_json_writer_key__trusted_literal(void **state) {
+  char json[64] = {0};
+  json_writer_t w;
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_obj_open(&w, NULL);
+  JSON_WRITER_KEY(&w, "temp");
+  json_writer_double_fixed(&w, 21.456, 1);
+  json_writer_obj_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("{\"temp\":21.5}", json);
+}
+
+/* template */
+
+static void test_json_writer_template__record(void **state) {
+  const char *keys[] = {"id", "ts"};
+  json_template_t tpl;
+  char fragments[32];
+  size_t offsets[3];
+  char json[64] = {0};
+  json_writer_t w;
+
+  assert_int_equal(0, json_template_init(&tpl, keys, 2, fragments,
+                                         sizeof(fragments), offsets));
+
+  json_writer_init(&w, json, sizeof(json));
+  json_writer_arr_open(&w, NULL);
+  json_writer_template_open(&w, &tpl);
+  json_writer_uint64(&w, 7);
+  json_writer_template_key(&w, &tpl, 1);
+  json_writer_int64(&w, -1);
+  json_writer_obj_close(&w);
+  json_writer_template_open(&w, &tpl);
+  json_writer_uint64(&w, 8);
+  json_writer_template_key(&w, &tpl, 1);
+  json_writer_null(&w);
+  json_writer_obj_close(&w);
+  json_writer_arr_close(&w);
+  assert_int_equal(JSON_OK, json_writer_finish(&w));
+  assert_string_equal("[{\"id\":7,\"ts\":-1},{\"id\":8,\"ts\":null}]", json);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_json_writer_init__empty),
+      cmocka_unit_test(test_json_writer_init__zero_size),
+      cmocka_unit_test(test_json_writer_init__null_buffer),
+
+      cmocka_unit_test(test_json_writer_finish__document),
+      cmocka_unit_test(test_json_writer_finish__exact_fit),
+      cmocka_unit_test(test_json_writer_finish__one_byte_short),
+      cmocka_unit_test(test_json_writer_finish__unclosed),
+      cmocka_unit_test(test_json_writer_finish__dangling_key),
+      cmocka_unit_test(test_json_writer_finish__top_level_values),
+      cmocka_unit_test(test_json_writer_finish__top_level_after_container),
+
+      cmocka_unit_test(test_json_writer_init_stream__same_output),
+      cmocka_unit_test(test_json_writer_init_stream__binary),
+      cmocka_unit_test(test_json_writer_init_stream__typed_arrays),
+      cmocka_unit_test(test_json_writer_init_stream__flush_error),
+      cmocka_unit_test(test_json_writer_init_stream__small_chunk),
+
+      cmocka_unit_test(test_json_writer_init_growable__same_output),
+      cmocka_unit_test(test_json_writer_init_growable__doubling),
+      cmocka_unit_test(test_json_writer_init_growable__alloc_error),
+      cmocka_unit_test(test_json_writer_init_growable__initial_alloc_error),
+      cmocka_unit_test(test_json_writer_release__finish_after_release),
+      cmocka_unit_test(test_json_writer_release__not_growable),
+
+      cmocka_unit_test(test_json_writer_init_iovec__reference),
+      cmocka_unit_test(test_json_writer_init_iovec__entries_full),
+      cmocka_unit_test(test_json_writer_init_iovec__raw),
+
+      cmocka_unit_test(test_json_writer_init_measure__exact_length),
+      cmocka_unit_test(test_json_writer_init_measure__long_string),
+      cmocka_unit_test(test_json_writer_init_measure__binary),
+      cmocka_unit_test(test_json_writer_init_measure__error),
+      cmocka_unit_test(test_json_writer_init_measure__exact_fit),
+
+      cmocka_unit_test(test_json_writer_nesting__commas),
+      cmocka_unit_test(test_json_writer_nesting__mismatched_close),
+      cmocka_unit_test(test_json_writer_nesting__close_nothing_open),
+      cmocka_unit_test(test_json_writer_nesting__value_without_key),
+      cmocka_unit_test(test_json_writer_nesting__key_in_array),
+      cmocka_unit_test(test_json_writer_nesting__max_depth),
+      cmocka_unit_test(test_json_writer_nesting__trailing_comma),
+
+      cmocka_unit_test(test_json_writer_options__utf8_raw),
+      cmocka_unit_test(test_json_writer_options__utf8_raw_invalid),
+      cmocka_unit_test(test_json_writer_options__solidus_raw),
+      cmocka_unit_test(test_json_writer_options__control_raw),
+
+#ifdef JSON_WRITER_STATS
+      cmocka_unit_test(test_json_writer_stats__counters),
+      cmocka_unit_test(test_json_writer_stats__overflow_offset),
+#else
+      cmocka_unit_test(test_json_writer_stats__disabled),
+#endif
+
+      cmocka_unit_test(test_json_writer_error__sticky),
+      cmocka_unit_test(test_json_writer_error__first_kept),
+
+      cmocka_unit_test(test_json_writer_depth__nested),
+
+      cmocka_unit_test(test_json_writer_reserve__unchecked),
+      cmocka_unit_test(test_json_writer_reserve__same_output),
+      cmocka_unit_test(test_json_writer_reserve__not_enough_room),
+      cmocka_unit_test(test_json_writer_reserve__stream),
+      cmocka_unit_test(test_json_writer_reserve__measure),
+
+      cmocka_unit_test(test_json_writer_key__trusted_literal),
+
+      cmocka_unit_test(test_json_writer_template__record),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}